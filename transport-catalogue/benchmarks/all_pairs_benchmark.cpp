@@ -0,0 +1,53 @@
+// Построение таблицы всех пар (движок ALL_PAIRS) на синтетической сети из 2000 остановок
+// (4000 вершин графа) при разном числе потоков. Блочный Флойд-Уоршелл параллелен внутри фазы,
+// поэтому ускорение близко к линейному, пока потоков не больше ядер. Маршруты от числа потоков
+// не зависят: сумма времен по выборке пар должна совпадать во всех строках
+#include "synthetic_network.h"
+#include "transport_catalogue.h"
+#include "transport_router.h"
+
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+int main() {
+    synthetic::NetworkOptions options;
+    options.stop_count = 2000;
+    options.bus_count = 200;
+    options.stops_per_bus = 20;
+    transport_catalogue::TransportCatalogue catalogue;
+    synthetic::FillCatalogue(catalogue, options);
+
+    std::vector<std::string> names;
+    for (size_t stop = 0; stop < options.stop_count; stop += 97) {
+        names.push_back(synthetic::StopName(stop));
+    }
+
+    std::printf("hardware threads: %u\n", std::thread::hardware_concurrency());
+    std::printf("%8s %10s %12s %10s %14s %14s\n", "threads", "vertices", "build_ms", "speedup", "kernel", "time_checksum");
+    double single_thread_ms = 0;
+    for (const size_t thread_count : {1, 2, 4, 8, 16}) {
+        transport_router::TransportRouter router(catalogue);
+        transport_router::RoutingSettings settings;
+        settings.bus_wait_time = 6;
+        settings.bus_velocity = 40;
+        settings.engine = transport_router::RouterEngine::ALL_PAIRS;
+        settings.thread_count = thread_count;
+        router.SetRoutingSettings(settings);
+        router.CreateGraph();
+        const transport_router::RouterStats stats = router.GetStats();
+        if (thread_count == 1) {
+            single_thread_ms = stats.build_duration_ms;
+        }
+
+        double checksum = 0;
+        for (const std::string& from : names) {
+            for (const std::string& to : names) {
+                checksum += router.GetRoute(from, to).total_time_.value_or(0);
+            }
+        }
+        std::printf("%8zu %10zu %12.1f %10.2f %14s %14.3f\n", thread_count, stats.vertex_count, stats.build_duration_ms,
+                    single_thread_ms / stats.build_duration_ms, stats.relax_kernel.c_str(), checksum);
+    }
+}
@@ -0,0 +1,59 @@
+// Иерархия сжатия против таблицы всех пар (graph::Router) на синтетических сетях: время
+// предрасчета, объем индекса и среднее время запроса Route. Таблица растет как V^2 по памяти
+// и V^3 по времени, иерархия - почти линейно, зато ее запрос - поиск, а не проход по таблице.
+// Маршруты совпадают, поэтому совпадает и сумма времен по выборке пар
+#include "synthetic_network.h"
+#include "transport_catalogue.h"
+#include "transport_router.h"
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace {
+
+double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+}  // namespace
+
+int main() {
+    std::printf("%8s %22s %12s %12s %12s %14s\n", "stops", "engine", "build_ms", "index_mb", "query_us", "time_checksum");
+    for (const size_t stop_count : {500, 1000, 2000}) {
+        synthetic::NetworkOptions options;
+        options.stop_count = stop_count;
+        options.bus_count = stop_count / 10;
+        options.stops_per_bus = 20;
+        transport_catalogue::TransportCatalogue catalogue;
+        synthetic::FillCatalogue(catalogue, options);
+
+        synthetic::Random random(7);
+        std::vector<std::pair<std::string, std::string>> pairs;
+        for (int i = 0; i < 2000; ++i) {
+            pairs.emplace_back(synthetic::StopName(random.Below(stop_count)), synthetic::StopName(random.Below(stop_count)));
+        }
+
+        for (const auto engine : {transport_router::RouterEngine::ALL_PAIRS, transport_router::RouterEngine::CONTRACTION_HIERARCHY}) {
+            transport_router::TransportRouter router(catalogue);
+            transport_router::RoutingSettings settings;
+            settings.bus_wait_time = 6;
+            settings.bus_velocity = 40;
+            settings.engine = engine;
+            router.SetRoutingSettings(settings);
+            router.CreateGraph();
+            const transport_router::RouterStats stats = router.GetStats();
+
+            double checksum = 0;
+            const auto start = std::chrono::steady_clock::now();
+            for (const auto& [from, to] : pairs) {
+                checksum += router.GetRoute(from, to).total_time_.value_or(0);
+            }
+            const double query_us = MillisecondsSince(start) * 1e3 / static_cast<double>(pairs.size());
+            std::printf("%8zu %22s %12.1f %12.1f %12.2f %14.3f\n", stop_count,
+                        engine == transport_router::RouterEngine::ALL_PAIRS ? "all_pairs" : "contraction_hierarchy",
+                        stats.build_duration_ms, static_cast<double>(stats.index_bytes) / (1 << 20), query_us, checksum);
+        }
+    }
+}
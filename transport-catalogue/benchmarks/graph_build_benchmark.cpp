@@ -0,0 +1,63 @@
+// Построение графа роутера на синтетических сетях до 50 тысяч остановок. При линейном
+// построении время на ребро не растет с размером сети. Движок DIJKSTRA ничего не
+// предрасчитывает, поэтому время построения - это сборка графа по справочнику
+#include "synthetic_network.h"
+#include "transport_catalogue.h"
+#include "transport_router.h"
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace {
+
+double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+}  // namespace
+
+int main() {
+    std::printf("%8s %8s %10s %12s %12s %12s %14s\n", "stops", "buses", "edges", "catalogue_ms", "graph_ms", "ns_per_edge", "lookup_ns");
+    for (const size_t stop_count : {6250, 12500, 25000, 50000}) {
+        synthetic::NetworkOptions options;
+        options.stop_count = stop_count;
+        options.bus_count = stop_count / 10;
+        options.stops_per_bus = 20;
+
+        transport_catalogue::TransportCatalogue catalogue;
+        auto start = std::chrono::steady_clock::now();
+        synthetic::FillCatalogue(catalogue, options);
+        const double catalogue_ms = MillisecondsSince(start);
+
+        // Поиск остановки по имени, как в каждом запросе маршрута
+        std::vector<std::string> names;
+        for (size_t stop = 0; stop < stop_count; stop += 7) {
+            names.push_back(synthetic::StopName(stop));
+        }
+        size_t checksum = 0;
+        start = std::chrono::steady_clock::now();
+        for (int round = 0; round < 20; ++round) {
+            for (const std::string& name : names) {
+                checksum += catalogue.FindStopIndex(name).value_or(0);
+            }
+        }
+        const double lookup_ns = MillisecondsSince(start) * 1e6 / static_cast<double>(20 * names.size());
+
+        transport_router::TransportRouter router(catalogue);
+        transport_router::RoutingSettings settings;
+        settings.bus_wait_time = 6;
+        settings.bus_velocity = 40;
+        settings.engine = transport_router::RouterEngine::DIJKSTRA;
+        router.SetRoutingSettings(settings);
+        router.CreateGraph();
+        const transport_router::RouterStats stats = router.GetStats();
+
+        std::printf("%8zu %8zu %10zu %12.1f %12.1f %12.1f %14.1f\n", stop_count, options.bus_count, stats.edge_count, catalogue_ms,
+                    stats.build_duration_ms, stats.build_duration_ms * 1e6 / static_cast<double>(stats.edge_count), lookup_ns);
+        if (checksum == 0) {
+            std::printf("unexpected empty lookups\n");
+        }
+    }
+}
@@ -0,0 +1,100 @@
+// Память и обход графа в двух видах: списки инцидентности (граф до Freeze) и сжатые строки (CSR).
+// Обход - полный поиск Дейкстры из нескольких корней, как у движков без предрасчета.
+// По спискам каждое ребро читается через GetEdge по его EdgeId, по сжатым строкам - концы и веса
+// дуг вершины лежат подряд. Сжатые строки хранят ребро один раз, с 32-битными концами и смещениями,
+// поэтому меньше списков и по памяти. Сумма расстояний в обоих видах одна и та же
+#include "graph.h"
+#include "synthetic_graph.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using Graph = graph::DirectedWeightedGraph<int64_t>;
+
+double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Сумма расстояний от root до достижимых вершин. for_each_arc(vertex, relax) перебирает дуги вершины
+template <typename ForEachArc>
+int64_t SumDistances(size_t vertex_count, graph::VertexId root, ForEachArc for_each_arc) {
+    std::vector<int64_t> weights(vertex_count, std::numeric_limits<int64_t>::max());
+    std::vector<std::pair<int64_t, graph::VertexId>> heap;
+    const auto heap_compare = std::greater<std::pair<int64_t, graph::VertexId>>{};
+    weights[root] = 0;
+    heap.emplace_back(0, root);
+    int64_t sum = 0;
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), heap_compare);
+        const auto [weight, vertex] = heap.back();
+        heap.pop_back();
+        if (weight > weights[vertex]) {
+            continue;
+        }
+        sum += weight;
+        for_each_arc(vertex, [&](graph::VertexId to, int64_t arc_weight) {
+            if (weight + arc_weight < weights[to]) {
+                weights[to] = weight + arc_weight;
+                heap.emplace_back(weights[to], to);
+                std::push_heap(heap.begin(), heap.end(), heap_compare);
+            }
+        });
+    }
+    return sum;
+}
+
+}  // namespace
+
+int main() {
+    constexpr size_t root_count = 5;
+    std::printf("%10s %10s %12s %12s %14s %14s %16s\n", "vertices", "edges", "lists_mb", "csr_mb", "lists_ms", "csr_ms", "distance_sum");
+    for (const size_t vertex_count : {10000, 100000, 1000000}) {
+        synthetic::GraphOptions options;
+        options.vertex_count = vertex_count;
+        options.edge_count = vertex_count * 4;
+        options.max_weight = 1000;
+        const Graph frozen = synthetic::MakeRandomGraph(options);
+        Graph lists(vertex_count);
+        for (graph::EdgeId edge_id = 0; edge_id < frozen.GetEdgeCount(); ++edge_id) {
+            lists.AddEdge(frozen.GetEdge(edge_id));
+        }
+
+        int64_t lists_sum = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t root = 0; root < root_count; ++root) {
+            lists_sum += SumDistances(vertex_count, root * vertex_count / root_count, [&lists](graph::VertexId vertex, auto relax) {
+                for (const graph::EdgeId edge_id : lists.GetIncidentEdges(vertex)) {
+                    const auto& edge = lists.GetEdge(edge_id);
+                    relax(edge.to, edge.weight);
+                }
+            });
+        }
+        const double lists_ms = MillisecondsSince(start) / root_count;
+
+        int64_t csr_sum = 0;
+        start = std::chrono::steady_clock::now();
+        for (size_t root = 0; root < root_count; ++root) {
+            csr_sum += SumDistances(vertex_count, root * vertex_count / root_count, [&frozen](graph::VertexId vertex, auto relax) {
+                for (const auto& arc : frozen.GetIncidentArcs(vertex)) {
+                    relax(arc.to, arc.weight);
+                }
+            });
+        }
+        const double csr_ms = MillisecondsSince(start) / root_count;
+
+        std::printf("%10zu %10zu %12.1f %12.1f %14.2f %14.2f %16lld\n", vertex_count, options.edge_count,
+                    static_cast<double>(lists.GetMemoryBytes()) / (1 << 20), static_cast<double>(frozen.GetMemoryBytes()) / (1 << 20),
+                    lists_ms, csr_ms, static_cast<long long>(csr_sum));
+        if (lists_sum != csr_sum) {
+            std::printf("distance sums differ: %lld\n", static_cast<long long>(lists_sum));
+        }
+    }
+}
@@ -0,0 +1,59 @@
+// Метки хабов против Дейкстры без предрасчета на синтетических сетях: время построения меток,
+// их число и объем, среднее время запроса Route. Метки окупаются, когда запросов много:
+// запрос - слияние двух коротких списков вместо поиска по всему графу.
+// Маршруты совпадают, поэтому совпадает и сумма времен по выборке пар
+#include "synthetic_network.h"
+#include "transport_catalogue.h"
+#include "transport_router.h"
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace {
+
+double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+}  // namespace
+
+int main() {
+    std::printf("%8s %12s %12s %12s %12s %12s %14s\n", "stops", "engine", "build_ms", "labels", "index_mb", "query_us", "time_checksum");
+    for (const size_t stop_count : {1000, 2000, 4000}) {
+        synthetic::NetworkOptions options;
+        options.stop_count = stop_count;
+        options.bus_count = stop_count / 10;
+        options.stops_per_bus = 20;
+        transport_catalogue::TransportCatalogue catalogue;
+        synthetic::FillCatalogue(catalogue, options);
+
+        synthetic::Random random(7);
+        std::vector<std::pair<std::string, std::string>> pairs;
+        for (int i = 0; i < 2000; ++i) {
+            pairs.emplace_back(synthetic::StopName(random.Below(stop_count)), synthetic::StopName(random.Below(stop_count)));
+        }
+
+        for (const auto engine : {transport_router::RouterEngine::DIJKSTRA, transport_router::RouterEngine::HUB_LABELS}) {
+            transport_router::TransportRouter router(catalogue);
+            transport_router::RoutingSettings settings;
+            settings.bus_wait_time = 6;
+            settings.bus_velocity = 40;
+            settings.engine = engine;
+            router.SetRoutingSettings(settings);
+            router.CreateGraph();
+            const transport_router::RouterStats stats = router.GetStats();
+
+            double checksum = 0;
+            const auto start = std::chrono::steady_clock::now();
+            for (const auto& [from, to] : pairs) {
+                checksum += router.GetRoute(from, to).total_time_.value_or(0);
+            }
+            const double query_us = MillisecondsSince(start) * 1e3 / static_cast<double>(pairs.size());
+            std::printf("%8zu %12s %12.1f %12zu %12.1f %12.2f %14.3f\n", stop_count,
+                        engine == transport_router::RouterEngine::DIJKSTRA ? "dijkstra" : "hub_labels", stats.build_duration_ms,
+                        stats.label_count, static_cast<double>(stats.index_bytes) / (1 << 20), query_us, checksum);
+        }
+    }
+}
@@ -0,0 +1,119 @@
+// Обработка stat_requests, где маршрутные запросы перемешаны с Bus, Stop и Map: роутер строится
+// либо последовательно при первом маршрутном запросе, либо в фоне, пока готовятся остальные ответы.
+// Выигрыш фона ограничен временем немаршрутных ответов и есть только при свободном втором ядре
+#include "json_reader.h"
+#include "map_renderer.h"
+#include "request_handler.h"
+#include "transport_catalogue.h"
+#include "transport_router.h"
+
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <thread>
+
+namespace {
+
+double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+std::string StopName(size_t stop) {
+    return "Stop " + std::to_string(stop);
+}
+
+// Остановки в узлах сетки side x side, автобус на каждой строке и каждом столбце сетки
+std::string MakeInput(size_t side, const std::string& engine) {
+    std::ostringstream out;
+    out << R"({"base_requests": [)";
+    for (size_t stop = 0; stop < side * side; ++stop) {
+        out << (stop ? "," : "") << R"({"type": "Stop", "name": ")" << StopName(stop) << R"(", "latitude": )"
+            << 55.0 + 0.004 * static_cast<double>(stop / side) << R"(, "longitude": )" << 37.0 + 0.006 * static_cast<double>(stop % side)
+            << R"(, "road_distances": {)";
+        bool first = true;
+        if (stop % side + 1 < side) {
+            out << '"' << StopName(stop + 1) << R"(": )" << 400 + stop * 37 % 400;
+            first = false;
+        }
+        if (stop + side < side * side) {
+            out << (first ? "" : ",") << '"' << StopName(stop + side) << R"(": )" << 400 + stop * 53 % 400;
+        }
+        out << "}}";
+    }
+    for (size_t line = 0; line < side; ++line) {
+        for (const bool is_row : {true, false}) {
+            out << R"(,{"type": "Bus", "name": ")" << (is_row ? "Row " : "Column ") << line << R"(", "stops": [)";
+            for (size_t i = 0; i < side; ++i) {
+                out << (i ? "," : "") << '"' << StopName(is_row ? line * side + i : i * side + line) << '"';
+            }
+            out << R"(], "is_roundtrip": false})";
+        }
+    }
+    out << R"(], "routing_settings": {"bus_wait_time": 6, "bus_velocity": 40, "router_engine": ")" << engine << R"("},
+        "render_settings": {"width": 1200, "height": 1200, "padding": 50, "line_width": 14, "stop_radius": 5,
+            "bus_label_font_size": 20, "bus_label_offset": [7, 15], "stop_label_font_size": 20,
+            "stop_label_offset": [7, -3], "underlayer_color": [255, 255, 255, 0.85], "underlayer_width": 3,
+            "color_palette": ["green", [255, 160, 0], "red"]},
+        "stat_requests": [)";
+    // На каждый маршрутный запрос - 4 запроса Stop, 1 Bus, карта на каждые 10 маршрутов
+    const size_t stop_count = side * side;
+    int id = 0;
+    for (size_t i = 0; i < 200; ++i) {
+        for (size_t j = 0; j < 4; ++j) {
+            out << (id ? "," : "");
+            ++id;
+            out << R"({"id": )" << id << R"(, "type": "Stop", "name": ")" << StopName((i * 4 + j) * 7919 % stop_count) << R"("})";
+        }
+        ++id;
+        out << R"(,{"id": )" << id << R"(, "type": "Bus", "name": "Row )" << i % side << R"("})";
+        if (i % 10 == 0) {
+            ++id;
+            out << R"(,{"id": )" << id << R"(, "type": "Map"})";
+        }
+        ++id;
+        out << R"(,{"id": )" << id << R"(, "type": "Route", "from": ")" << StopName(i * 131 % stop_count) << R"(", "to": ")"
+            << StopName(i * 977 % stop_count) << R"("})";
+    }
+    out << "]}";
+    return out.str();
+}
+
+// Полный цикл, как в main; возвращает напечатанный ответ
+std::string Process(const std::string& input, bool background) {
+    transport_catalogue::TransportCatalogue catalogue;
+    renderer::MapRenderer renderer;
+    transport_router::TransportRouter router(catalogue);
+    RequestHandler request_handler(catalogue, renderer, router);
+    json_reader::JsonReader reader(request_handler);
+
+    std::istringstream in(input);
+    reader.ReadRequests(in);
+    reader.HandleBaseRequests();
+    reader.HandleRoutingSettings();
+    reader.HandleUpdateRequests();
+    reader.StartRouterBuild(background);
+    reader.HandleRenderSettings();
+    std::ostringstream out;
+    reader.HandleStatRequest(out);
+    return out.str();
+}
+
+}  // namespace
+
+int main() {
+    std::printf("hardware threads: %u\n", std::thread::hardware_concurrency());
+    std::printf("%8s %10s %14s %14s %8s\n", "stops", "engine", "sequential_ms", "background_ms", "same");
+    for (const size_t side : {20, 30}) {
+        for (const char* engine : {"all_pairs", "dijkstra"}) {
+            const std::string input = MakeInput(side, engine);
+            auto start = std::chrono::steady_clock::now();
+            const std::string sequential = Process(input, false);
+            const double sequential_ms = MillisecondsSince(start);
+            start = std::chrono::steady_clock::now();
+            const std::string background = Process(input, true);
+            const double background_ms = MillisecondsSince(start);
+            std::printf("%8zu %10s %14.1f %14.1f %8s\n", side * side, engine, sequential_ms, background_ms, sequential == background ? "yes" : "no");
+        }
+    }
+}
@@ -0,0 +1,801 @@
+#pragma once
+
+#include "graph.h"
+#include "parallel.h"
+#include "router.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// Иерархия сжатия (contraction hierarchies). Вершины по очереди сжимаются в порядке важности,
+// вместо сжатой вершины добавляются ярлыки (shortcuts), если без нее кратчайший путь
+// между соседями теряется. Запрос - двунаправленная Дейкстра только по ребрам "вверх" по рангу,
+// найденный путь раскрывается в исходные EdgeId графа. Из равных путей при положительных весах выбирается
+// тот же, что у Router: с наименьшим последним ребром, и так от конца пути к началу
+template <typename Weight>
+class ContractionHierarchy {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    using RouteInfo = typename Router<Weight>::RouteInfo;
+
+    ContractionHierarchy() = default;
+    explicit ContractionHierarchy(Graph graph);
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
+    // Веса кратчайших путей из всех sources во все targets по строкам: элемент i * targets.size() + j -
+    // из sources[i] в targets[j], пустой, если пути нет. Алгоритм с корзинами: обратные поиски вверх
+    // от целей оставляют в каждой достигнутой вершине запись (цель, вес), прямые поиски от источников
+    // просматривают корзины достигнутых вершин. Поиски каждой стороны идут параллельно
+    std::vector<std::optional<Weight>> BuildDistanceMatrix(const std::vector<VertexId>& sources, const std::vector<VertexId>& targets,
+                                                           size_t thread_count = 1) const;
+
+    size_t GetShortcutCount() const {
+        return shortcuts_.size();
+    }
+
+    size_t GetIndexBytes() const {
+        return (upward_arcs_.arcs.size() + downward_arcs_.arcs.size()) * sizeof(Arc)
+               + (upward_arcs_.offsets.size() + downward_arcs_.offsets.size() + in_edge_offsets_.size()) * sizeof(size_t)
+               + shortcuts_.size() * sizeof(Shortcut) + ranks_.size() * sizeof(uint32_t) + in_edges_.size() * sizeof(EdgeId);
+    }
+
+    graph::DirectedWeightedGraph<Weight>& GetGraph() {
+        return graph_;
+    }
+
+    const graph::DirectedWeightedGraph<Weight>& GetGraph() const {
+        return graph_;
+    }
+
+private:
+    // Дуга рабочего графа или графа поиска. id < числа ребер - исходное ребро, иначе ярлык
+    struct Arc {
+        VertexId vertex;
+        Weight weight;
+        EdgeId id;
+    };
+
+    // Списки дуг графа поиска одним массивом: дуги вершины v - arcs[offsets[v]..offsets[v + 1])
+    struct ArcLists {
+        std::vector<size_t> offsets;
+        std::vector<Arc> arcs;
+
+        ranges::Range<const Arc*> Get(VertexId vertex) const {
+            return {arcs.data() + offsets[vertex], arcs.data() + offsets[vertex + 1]};
+        }
+    };
+
+    // Запись корзины: цель обратного поиска и вес пути от вершины корзины до нее
+    struct BucketEntry {
+        size_t target;
+        Weight weight;
+    };
+
+    // Ярлык заменяет путь из двух дуг через сжатую вершину
+    struct Shortcut {
+        EdgeId first;
+        EdgeId second;
+    };
+
+    // Лимиты вершин, просматриваемых поиском свидетеля при оценке приоритета и при сжатии.
+    // При оценке свидетелем считается только прямая дуга соседа - так оценка в разы дешевле.
+    // Если свидетель не найден за лимит, ярлык добавляется: лишний ярлык не нарушает
+    // корректность, только увеличивает граф
+    static constexpr size_t ESTIMATE_SETTLE_LIMIT = 1;
+    static constexpr size_t CONTRACT_SETTLE_LIMIT = 200;
+
+    struct ContractionState {
+        std::vector<std::vector<Arc>> out_arcs;
+        std::vector<std::vector<Arc>> in_arcs;
+        std::vector<bool> contracted;
+        std::vector<int> contracted_neighbors;
+        // Рабочие массивы поиска свидетелей
+        std::vector<Weight> witness_weights;
+        std::vector<uint32_t> witness_marks;
+        uint32_t witness_mark = 0;
+        // Концы исходящих дуг сжимаемой вершины: поиск заканчивается, когда все они извлечены
+        std::vector<uint32_t> target_marks;
+        uint32_t target_mark = 0;
+        std::vector<std::pair<Weight, VertexId>> heap;
+        // Позиции дуг из indexed_vertex в out_arcs по концу дуги, чтобы параллельная дуга
+        // находилась за O(1). Индекс сбрасывается, когда списки дуг перестраиваются
+        std::vector<size_t> arc_positions;
+        std::vector<uint32_t> position_marks;
+        uint32_t position_mark = 0;
+        std::optional<VertexId> indexed_vertex;
+    };
+
+    struct SearchScratch {
+        std::vector<Weight> weights[2];
+        std::vector<EdgeId> parent_arcs[2];
+        std::vector<uint32_t> marks[2];
+        uint32_t search_mark = 0;
+        // Метки поиска последнего ребра среди равных путей: вес до конца пути и ребро, с которого он начат.
+        // Поисков несколько на запрос, поэтому у них своя пометка, а прямой поиск запроса остается в weights[0]
+        std::vector<Weight> tie_weights;
+        std::vector<EdgeId> tie_edges;
+        std::vector<uint32_t> tie_marks;
+        uint32_t tie_mark = 0;
+
+        void Prepare(size_t vertex_count) {
+            for (int side = 0; side < 2; ++side) {
+                if (marks[side].size() < vertex_count) {
+                    weights[side].resize(vertex_count);
+                    parent_arcs[side].resize(vertex_count);
+                    marks[side].resize(vertex_count, 0);
+                }
+            }
+            if (tie_marks.size() < vertex_count) {
+                tie_weights.resize(vertex_count);
+                tie_edges.resize(vertex_count);
+                tie_marks.resize(vertex_count, 0);
+            }
+            if (++search_mark == 0) {
+                std::fill(marks[0].begin(), marks[0].end(), 0);
+                std::fill(marks[1].begin(), marks[1].end(), 0);
+                search_mark = 1;
+            }
+        }
+
+        void NextTieMark() {
+            if (++tie_mark == 0) {
+                std::fill(tie_marks.begin(), tie_marks.end(), 0);
+                tie_mark = 1;
+            }
+        }
+    };
+
+    static SearchScratch& GetScratch() {
+        static thread_local SearchScratch scratch;
+        return scratch;
+    }
+
+    void Contract();
+    // Число ярлыков, которые добавило бы сжатие vertex; при add_shortcuts они добавляются
+    int ContractVertex(ContractionState& state, VertexId vertex, bool add_shortcuts);
+    // Поиск свидетелей из from в рабочем графе в обход skipped до расстояния limit.
+    // Расстояния остаются в witness_weights для вершин с текущей witness_mark
+    void SearchWitnesses(ContractionState& state, VertexId from, VertexId skipped, Weight limit,
+                         size_t target_count, size_t settle_limit) const;
+    void AddArc(ContractionState& state, VertexId from, VertexId to, Weight weight, EdgeId id);
+    void BuildSearchGraph();
+    void UnpackArc(EdgeId arc, std::vector<EdgeId>& edges) const;
+    // Поиск вверх по рангу от source: side 0 - прямой по upward_arcs_, side 1 - обратный по downward_arcs_.
+    // visit(vertex, weight) вызывается для каждой извлеченной вершины, не остановленной по требованию
+    template <typename Visit>
+    void SearchUpward(int side, VertexId source, Visit visit) const;
+    // Наименьшее входящее в vertex ребро с EdgeId меньше limit, которым кончается кратчайший путь
+    // от корня прямого поиска, если до vertex weight. Без такого ребра - limit. Обратный поиск вверх
+    // идет сразу от начал всех ребер-кандидатов с ключом (вес, ребро) и встречается с прямым
+    EdgeId FindFirstTightEdge(VertexId vertex, Weight weight, EdgeId limit) const;
+
+    static constexpr Weight ZERO_WEIGHT{};
+    Graph graph_;
+    std::vector<uint32_t> ranks_;
+    std::vector<Shortcut> shortcuts_;
+    // Дуги, по которым идут поиски: upward_arcs_[v] - из v в вершины выше рангом,
+    // downward_arcs_[v] - дуги из вершин выше рангом в v, хранящиеся с их началом
+    ArcLists upward_arcs_;
+    ArcLists downward_arcs_;
+    // Входящие ребра исходного графа: в vertex - in_edges_[in_edge_offsets_[vertex]..in_edge_offsets_[vertex + 1]),
+    // по возрастанию EdgeId
+    std::vector<size_t> in_edge_offsets_;
+    std::vector<EdgeId> in_edges_;
+    // С ребрами нулевого веса путь не уточняется: равных путей может быть сколько угодно длинных
+    bool has_zero_weight_ = false;
+};
+
+template <typename Weight>
+ContractionHierarchy<Weight>::ContractionHierarchy(Graph graph)
+    : graph_(std::move(graph))
+{
+    graph_.Freeze();
+    for (EdgeId edge_id = 0; edge_id < graph_.GetEdgeCount(); ++edge_id) {
+        if (graph_.GetEdge(edge_id).weight < ZERO_WEIGHT) {
+            throw std::domain_error("Edges' weights should be non-negative");
+        }
+        has_zero_weight_ = has_zero_weight_ || graph_.GetEdge(edge_id).weight == ZERO_WEIGHT;
+    }
+    Contract();
+    BuildSearchGraph();
+}
+
+template <typename Weight>
+void ContractionHierarchy<Weight>::AddArc(ContractionState& state, VertexId from, VertexId to, Weight weight, EdgeId id) {
+    std::vector<Arc>& out_arcs = state.out_arcs[from];
+    if (state.indexed_vertex != from) {
+        if (++state.position_mark == 0) {
+            std::fill(state.position_marks.begin(), state.position_marks.end(), 0);
+            state.position_mark = 1;
+        }
+        for (size_t i = 0; i < out_arcs.size(); ++i) {
+            state.arc_positions[out_arcs[i].vertex] = i;
+            state.position_marks[out_arcs[i].vertex] = state.position_mark;
+        }
+        state.indexed_vertex = from;
+    }
+
+    // Из параллельных дуг в рабочем графе остается самая легкая
+    if (state.position_marks[to] == state.position_mark) {
+        Arc& arc = out_arcs[state.arc_positions[to]];
+        if (weight < arc.weight) {
+            arc.weight = weight;
+            arc.id = id;
+            for (Arc& in_arc : state.in_arcs[to]) {
+                if (in_arc.vertex == from) {
+                    in_arc.weight = weight;
+                    in_arc.id = id;
+                }
+            }
+        }
+        return;
+    }
+    state.arc_positions[to] = out_arcs.size();
+    state.position_marks[to] = state.position_mark;
+    out_arcs.push_back({to, weight, id});
+    state.in_arcs[to].push_back({from, weight, id});
+}
+
+template <typename Weight>
+void ContractionHierarchy<Weight>::SearchWitnesses(ContractionState& state, VertexId from, VertexId skipped, Weight limit,
+                                                   size_t target_count, size_t settle_limit) const {
+    if (++state.witness_mark == 0) {
+        std::fill(state.witness_marks.begin(), state.witness_marks.end(), 0);
+        state.witness_mark = 1;
+    }
+    auto& heap = state.heap;
+    const auto heap_compare = std::greater<std::pair<Weight, VertexId>>{};
+    heap.clear();
+    state.witness_marks[from] = state.witness_mark;
+    state.witness_weights[from] = ZERO_WEIGHT;
+    heap.emplace_back(ZERO_WEIGHT, from);
+
+    size_t settled = 0;
+    while (!heap.empty() && settled < settle_limit && target_count > 0) {
+        std::pop_heap(heap.begin(), heap.end(), heap_compare);
+        const auto [weight, vertex] = heap.back();
+        heap.pop_back();
+        if (weight > state.witness_weights[vertex]) {
+            continue;
+        }
+        ++settled;
+        if (state.target_marks[vertex] == state.target_mark) {
+            --target_count;
+        }
+        for (const Arc& arc : state.out_arcs[vertex]) {
+            if (arc.vertex == skipped) {
+                continue;
+            }
+            const Weight candidate_weight = weight + arc.weight;
+            if (candidate_weight > limit) {
+                continue;
+            }
+            if (state.witness_marks[arc.vertex] != state.witness_mark || candidate_weight < state.witness_weights[arc.vertex]) {
+                state.witness_marks[arc.vertex] = state.witness_mark;
+                state.witness_weights[arc.vertex] = candidate_weight;
+                heap.emplace_back(candidate_weight, arc.vertex);
+                std::push_heap(heap.begin(), heap.end(), heap_compare);
+            }
+        }
+    }
+}
+
+template <typename Weight>
+int ContractionHierarchy<Weight>::ContractVertex(ContractionState& state, VertexId vertex, bool add_shortcuts) {
+    int shortcut_count = 0;
+    // Ярлыки меняют списки соседей, но не самой вершины
+    const std::vector<Arc>& in_arcs = state.in_arcs[vertex];
+    const std::vector<Arc>& out_arcs = state.out_arcs[vertex];
+    if (++state.target_mark == 0) {
+        std::fill(state.target_marks.begin(), state.target_marks.end(), 0);
+        state.target_mark = 1;
+    }
+    Weight max_out_weight = ZERO_WEIGHT;
+    for (const Arc& out_arc : out_arcs) {
+        max_out_weight = std::max(max_out_weight, out_arc.weight);
+        state.target_marks[out_arc.vertex] = state.target_mark;
+    }
+    for (const Arc& in_arc : in_arcs) {
+        if (in_arc.vertex == vertex) {
+            continue;
+        }
+        // Один поиск от соседа покрывает все пары (in_arc, out_arc). Свидетель - путь не длиннее
+        // пути через vertex; найденный на подграфе путь всегда настоящий, поэтому ошибка лимита
+        // приводит только к лишнему ярлыку
+        SearchWitnesses(state, in_arc.vertex, vertex, in_arc.weight + max_out_weight, out_arcs.size(),
+                        add_shortcuts ? CONTRACT_SETTLE_LIMIT : ESTIMATE_SETTLE_LIMIT);
+        for (const Arc& out_arc : out_arcs) {
+            if (out_arc.vertex == vertex || out_arc.vertex == in_arc.vertex) {
+                continue;
+            }
+            const Weight shortcut_weight = in_arc.weight + out_arc.weight;
+            if (state.witness_marks[out_arc.vertex] == state.witness_mark
+                && state.witness_weights[out_arc.vertex] <= shortcut_weight) {
+                continue;
+            }
+            ++shortcut_count;
+            if (add_shortcuts) {
+                const EdgeId id = graph_.GetEdgeCount() + shortcuts_.size();
+                shortcuts_.push_back({in_arc.id, out_arc.id});
+                AddArc(state, in_arc.vertex, out_arc.vertex, shortcut_weight, id);
+            }
+        }
+    }
+    return shortcut_count;
+}
+
+template <typename Weight>
+void ContractionHierarchy<Weight>::Contract() {
+    const size_t vertex_count = graph_.GetVertexCount();
+    ContractionState state;
+    state.out_arcs.resize(vertex_count);
+    state.in_arcs.resize(vertex_count);
+    state.contracted.assign(vertex_count, false);
+    state.contracted_neighbors.assign(vertex_count, 0);
+    state.witness_weights.resize(vertex_count);
+    state.witness_marks.assign(vertex_count, 0);
+    state.target_marks.assign(vertex_count, 0);
+    state.arc_positions.resize(vertex_count);
+    state.position_marks.assign(vertex_count, 0);
+    for (EdgeId edge_id = 0; edge_id < graph_.GetEdgeCount(); ++edge_id) {
+        const auto& edge = graph_.GetEdge(edge_id);
+        if (edge.from != edge.to) {
+            AddArc(state, edge.from, edge.to, edge.weight, edge_id);
+        }
+    }
+
+    // Приоритет: разность ярлыков и удаляемых дуг плюс число уже сжатых соседей.
+    // Очередь с ленивым пересчетом: извлеченная вершина сжимается, только если ее
+    // пересчитанный приоритет не хуже следующего в очереди
+    const auto priority = [&](VertexId vertex) {
+        const int removed_arcs = static_cast<int>(state.in_arcs[vertex].size() + state.out_arcs[vertex].size());
+        return ContractVertex(state, vertex, false) - removed_arcs + state.contracted_neighbors[vertex];
+    };
+    using QueueItem = std::pair<int, VertexId>;
+    std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> queue;
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        queue.emplace(priority(vertex), vertex);
+    }
+
+    ranks_.assign(vertex_count, 0);
+    uint32_t next_rank = 0;
+    while (!queue.empty()) {
+        const VertexId vertex = queue.top().second;
+        queue.pop();
+        if (state.contracted[vertex]) {
+            continue;
+        }
+        const int current_priority = priority(vertex);
+        if (!queue.empty() && current_priority > queue.top().first) {
+            queue.emplace(current_priority, vertex);
+            continue;
+        }
+
+        ContractVertex(state, vertex, true);
+        state.contracted[vertex] = true;
+        ranks_[vertex] = next_rank++;
+
+        // Соседи забывают о сжатой вершине, чтобы списки не разрастались
+        const auto forget_vertex = [vertex](std::vector<Arc>& arcs) {
+            arcs.erase(std::remove_if(arcs.begin(), arcs.end(), [vertex](const Arc& arc) {
+                return arc.vertex == vertex;
+            }), arcs.end());
+        };
+        for (const Arc& arc : state.in_arcs[vertex]) {
+            forget_vertex(state.out_arcs[arc.vertex]);
+            ++state.contracted_neighbors[arc.vertex];
+        }
+        for (const Arc& arc : state.out_arcs[vertex]) {
+            forget_vertex(state.in_arcs[arc.vertex]);
+            ++state.contracted_neighbors[arc.vertex];
+        }
+        state.indexed_vertex.reset();
+        std::vector<Arc>().swap(state.in_arcs[vertex]);
+        std::vector<Arc>().swap(state.out_arcs[vertex]);
+    }
+}
+
+template <typename Weight>
+void ContractionHierarchy<Weight>::BuildSearchGraph() {
+    const size_t vertex_count = graph_.GetVertexCount();
+    std::vector<std::vector<Arc>> upward_arcs(vertex_count);
+    std::vector<std::vector<Arc>> downward_arcs(vertex_count);
+
+    const auto add_arc = [&](VertexId from, VertexId to, Weight weight, EdgeId id) {
+        if (from == to) {
+            return;
+        }
+        if (ranks_[from] < ranks_[to]) {
+            upward_arcs[from].push_back({to, weight, id});
+        } else {
+            downward_arcs[to].push_back({from, weight, id});
+        }
+    };
+    for (EdgeId edge_id = 0; edge_id < graph_.GetEdgeCount(); ++edge_id) {
+        const auto& edge = graph_.GetEdge(edge_id);
+        add_arc(edge.from, edge.to, edge.weight, edge_id);
+    }
+
+    // Начало, конец и вес ярлыка восстанавливаются по его составным дугам
+    std::vector<VertexId> shortcut_from(shortcuts_.size());
+    std::vector<VertexId> shortcut_to(shortcuts_.size());
+    std::vector<Weight> shortcut_weight(shortcuts_.size());
+    const EdgeId edge_count = graph_.GetEdgeCount();
+    const auto arc_from = [&](EdgeId id) {
+        return id < edge_count ? graph_.GetEdge(id).from : shortcut_from[id - edge_count];
+    };
+    const auto arc_to = [&](EdgeId id) {
+        return id < edge_count ? graph_.GetEdge(id).to : shortcut_to[id - edge_count];
+    };
+    const auto arc_weight = [&](EdgeId id) {
+        return id < edge_count ? graph_.GetEdge(id).weight : shortcut_weight[id - edge_count];
+    };
+    // Ярлык ссылается только на более ранние дуги, поэтому хватает одного прохода по порядку
+    for (size_t i = 0; i < shortcuts_.size(); ++i) {
+        shortcut_from[i] = arc_from(shortcuts_[i].first);
+        shortcut_to[i] = arc_to(shortcuts_[i].second);
+        shortcut_weight[i] = arc_weight(shortcuts_[i].first) + arc_weight(shortcuts_[i].second);
+        add_arc(shortcut_from[i], shortcut_to[i], shortcut_weight[i], edge_count + i);
+    }
+
+    // Запросы идут по сплошным массивам дуг, а не по отдельному вектору на вершину
+    const auto flatten = [vertex_count](std::vector<std::vector<Arc>>& lists, ArcLists& result) {
+        result.offsets.assign(vertex_count + 1, 0);
+        for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+            result.offsets[vertex + 1] = result.offsets[vertex] + lists[vertex].size();
+        }
+        result.arcs.clear();
+        result.arcs.reserve(result.offsets.back());
+        for (auto& arcs : lists) {
+            result.arcs.insert(result.arcs.end(), arcs.begin(), arcs.end());
+            std::vector<Arc>().swap(arcs);
+        }
+    };
+    flatten(upward_arcs, upward_arcs_);
+    flatten(downward_arcs, downward_arcs_);
+
+    // Ребра раскладываются по концам в порядке EdgeId, поэтому каждый список уже отсортирован
+    in_edge_offsets_.assign(vertex_count + 1, 0);
+    for (EdgeId edge_id = 0; edge_id < edge_count; ++edge_id) {
+        ++in_edge_offsets_[graph_.GetEdge(edge_id).to + 1];
+    }
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        in_edge_offsets_[vertex + 1] += in_edge_offsets_[vertex];
+    }
+    in_edges_.resize(edge_count);
+    std::vector<size_t> positions(in_edge_offsets_.begin(), in_edge_offsets_.end() - 1);
+    for (EdgeId edge_id = 0; edge_id < edge_count; ++edge_id) {
+        in_edges_[positions[graph_.GetEdge(edge_id).to]++] = edge_id;
+    }
+}
+
+template <typename Weight>
+void ContractionHierarchy<Weight>::UnpackArc(EdgeId arc, std::vector<EdgeId>& edges) const {
+    std::vector<EdgeId> stack{arc};
+    while (!stack.empty()) {
+        const EdgeId id = stack.back();
+        stack.pop_back();
+        if (id < graph_.GetEdgeCount()) {
+            edges.push_back(id);
+        } else {
+            const Shortcut& shortcut = shortcuts_[id - graph_.GetEdgeCount()];
+            stack.push_back(shortcut.second);
+            stack.push_back(shortcut.first);
+        }
+    }
+}
+
+template <typename Weight>
+std::optional<typename ContractionHierarchy<Weight>::RouteInfo> ContractionHierarchy<Weight>::BuildRoute(VertexId from,
+                                                                                                         VertexId to) const {
+    const size_t vertex_count = graph_.GetVertexCount();
+    if (from >= vertex_count || to >= vertex_count) {
+        throw std::out_of_range("vertex is out of range");
+    }
+    static constexpr EdgeId NO_ARC = std::numeric_limits<EdgeId>::max();
+
+    SearchScratch& scratch = GetScratch();
+    scratch.Prepare(vertex_count);
+    const auto reached = [&scratch](int side, VertexId vertex) {
+        return scratch.marks[side][vertex] == scratch.search_mark;
+    };
+
+    using QueueItem = std::pair<Weight, VertexId>;
+    std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> queues[2];
+    const VertexId sources[2] = {from, to};
+    for (int side = 0; side < 2; ++side) {
+        scratch.marks[side][sources[side]] = scratch.search_mark;
+        scratch.weights[side][sources[side]] = ZERO_WEIGHT;
+        scratch.parent_arcs[side][sources[side]] = NO_ARC;
+        queues[side].emplace(ZERO_WEIGHT, sources[side]);
+    }
+
+    std::optional<Weight> best_weight;
+    VertexId meeting_vertex = from;
+    // Сторона 0 - прямой поиск от from по upward_arcs_, сторона 1 - обратный от to по downward_arcs_
+    while (!queues[0].empty() || !queues[1].empty()) {
+        for (int side = 0; side < 2; ++side) {
+            auto& queue = queues[side];
+            if (queue.empty()) {
+                continue;
+            }
+            const auto [weight, vertex] = queue.top();
+            queue.pop();
+            if (weight > scratch.weights[side][vertex]) {
+                continue;
+            }
+            if (best_weight && weight >= *best_weight) {
+                // Дальше по этой стороне путь короче найденного уже не получить
+                queue = {};
+                continue;
+            }
+            if (reached(1 - side, vertex)) {
+                const Weight total_weight = weight + scratch.weights[1 - side][vertex];
+                if (!best_weight || total_weight < *best_weight) {
+                    best_weight = total_weight;
+                    meeting_vertex = vertex;
+                }
+            }
+            // Остановка по требованию: если до вершины короче дойти сверху, ее путь не кратчайший
+            // и продолжать поиск из нее бессмысленно
+            const auto stall_arcs = (side == 0 ? downward_arcs_ : upward_arcs_).Get(vertex);
+            const bool stalled = std::any_of(stall_arcs.begin(), stall_arcs.end(), [&](const Arc& arc) {
+                return reached(side, arc.vertex) && scratch.weights[side][arc.vertex] + arc.weight < weight;
+            });
+            if (stalled) {
+                continue;
+            }
+            for (const Arc& arc : (side == 0 ? upward_arcs_ : downward_arcs_).Get(vertex)) {
+                const Weight candidate_weight = weight + arc.weight;
+                if (!reached(side, arc.vertex) || candidate_weight < scratch.weights[side][arc.vertex]) {
+                    scratch.marks[side][arc.vertex] = scratch.search_mark;
+                    scratch.weights[side][arc.vertex] = candidate_weight;
+                    scratch.parent_arcs[side][arc.vertex] = arc.id;
+                    queue.emplace(candidate_weight, arc.vertex);
+                }
+            }
+        }
+    }
+
+    if (!best_weight) {
+        return std::nullopt;
+    }
+
+    const EdgeId edge_count = graph_.GetEdgeCount();
+    // Концы дуги-ярлыка - концы первой и последней исходных дуг в его раскрытии
+    const auto arc_from = [&](EdgeId id) {
+        while (id >= edge_count) {
+            id = shortcuts_[id - edge_count].first;
+        }
+        return graph_.GetEdge(id).from;
+    };
+    const auto arc_to = [&](EdgeId id) {
+        while (id >= edge_count) {
+            id = shortcuts_[id - edge_count].second;
+        }
+        return graph_.GetEdge(id).to;
+    };
+
+    std::vector<EdgeId> forward_arcs;
+    for (VertexId vertex = meeting_vertex; scratch.parent_arcs[0][vertex] != NO_ARC;) {
+        forward_arcs.push_back(scratch.parent_arcs[0][vertex]);
+        vertex = arc_from(forward_arcs.back());
+    }
+    std::reverse(forward_arcs.begin(), forward_arcs.end());
+    for (VertexId vertex = meeting_vertex; scratch.parent_arcs[1][vertex] != NO_ARC;) {
+        forward_arcs.push_back(scratch.parent_arcs[1][vertex]);
+        vertex = arc_to(forward_arcs.back());
+    }
+
+    std::vector<EdgeId> edges;
+    Weight weight = ZERO_WEIGHT;
+    for (const EdgeId arc : forward_arcs) {
+        UnpackArc(arc, edges);
+    }
+    std::vector<Weight> arrival_weights;
+    arrival_weights.reserve(edges.size());
+    for (const EdgeId edge_id : edges) {
+        weight += graph_.GetEdge(edge_id).weight;
+        arrival_weights.push_back(weight);
+    }
+    if (has_zero_weight_) {
+        return RouteInfo{weight, std::move(edges)};
+    }
+
+    // Путь собирается заново от to: последним берется наименьшее из ребер, которыми кончаются
+    // кратчайшие пути до текущей вершины. Ребро найденного пути годится всегда, поэтому для вершин
+    // этого пути ищутся только ребра меньше него, а вершина с одним входящим ребром не ищется вовсе
+    std::vector<EdgeId> canonical_edges;
+    VertexId vertex = to;
+    Weight vertex_weight = weight;
+    size_t position = edges.size();
+    while (vertex != from) {
+        while (position > 0 && arrival_weights[position - 1] > vertex_weight) {
+            --position;
+        }
+        EdgeId edge_id = NO_ARC;
+        if (position > 0 && arrival_weights[position - 1] == vertex_weight && graph_.GetEdge(edges[position - 1]).to == vertex) {
+            edge_id = edges[position - 1];
+        }
+        const size_t first_in_edge = in_edge_offsets_[vertex];
+        if (edge_id == NO_ARC && in_edge_offsets_[vertex + 1] - first_in_edge == 1) {
+            edge_id = in_edges_[first_in_edge];
+        } else if (in_edges_[first_in_edge] < edge_id) {
+            edge_id = FindFirstTightEdge(vertex, vertex_weight, edge_id);
+        }
+        if (edge_id == NO_ARC) {
+            // Недостижимо при положительных весах: до вершины на кратчайшем пути всегда ведет ребро
+            return RouteInfo{weight, std::move(edges)};
+        }
+        canonical_edges.push_back(edge_id);
+        vertex_weight -= graph_.GetEdge(edge_id).weight;
+        vertex = graph_.GetEdge(edge_id).from;
+    }
+    std::reverse(canonical_edges.begin(), canonical_edges.end());
+    return RouteInfo{weight, std::move(canonical_edges)};
+}
+
+template <typename Weight>
+EdgeId ContractionHierarchy<Weight>::FindFirstTightEdge(VertexId vertex, Weight weight, EdgeId limit) const {
+    SearchScratch& scratch = GetScratch();
+    scratch.NextTieMark();
+    const auto reached = [&scratch](VertexId other) {
+        return scratch.tie_marks[other] == scratch.tie_mark;
+    };
+    // Ключ (вес, ребро) сравнивается лексикографически: в вершине остается наименьшее ребро из дающих
+    // кратчайший путь до vertex, и прибавление веса дуги порядок ключей не меняет
+    const auto improves = [&](VertexId other, Weight other_weight, EdgeId edge_id) {
+        return !reached(other) || other_weight < scratch.tie_weights[other]
+               || (other_weight == scratch.tie_weights[other] && edge_id < scratch.tie_edges[other]);
+    };
+
+    using QueueItem = std::tuple<Weight, EdgeId, VertexId>;
+    std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> queue;
+    for (size_t i = in_edge_offsets_[vertex]; i < in_edge_offsets_[vertex + 1] && in_edges_[i] < limit; ++i) {
+        const auto& edge = graph_.GetEdge(in_edges_[i]);
+        if (edge.from != vertex && edge.weight <= weight && improves(edge.from, edge.weight, in_edges_[i])) {
+            scratch.tie_marks[edge.from] = scratch.tie_mark;
+            scratch.tie_weights[edge.from] = edge.weight;
+            scratch.tie_edges[edge.from] = in_edges_[i];
+            queue.emplace(edge.weight, in_edges_[i], edge.from);
+        }
+    }
+
+    // Прямой поиск запроса верно нашел веса всех вершин ближе to. Любой вес прямого поиска - вес
+    // настоящего пути, поэтому равенство означает кратчайший путь, который кончается ребром метки
+    EdgeId best_edge = limit;
+    while (!queue.empty()) {
+        const auto [other_weight, edge_id, other] = queue.top();
+        queue.pop();
+        if (other_weight != scratch.tie_weights[other] || edge_id != scratch.tie_edges[other] || edge_id >= best_edge) {
+            continue;
+        }
+        if (scratch.marks[0][other] == scratch.search_mark && scratch.weights[0][other] + other_weight == weight) {
+            best_edge = edge_id;
+            continue;
+        }
+        for (const Arc& arc : downward_arcs_.Get(other)) {
+            const Weight candidate_weight = other_weight + arc.weight;
+            if (candidate_weight <= weight && improves(arc.vertex, candidate_weight, edge_id)) {
+                scratch.tie_marks[arc.vertex] = scratch.tie_mark;
+                scratch.tie_weights[arc.vertex] = candidate_weight;
+                scratch.tie_edges[arc.vertex] = edge_id;
+                queue.emplace(candidate_weight, edge_id, arc.vertex);
+            }
+        }
+    }
+    return best_edge;
+}
+
+template <typename Weight>
+template <typename Visit>
+void ContractionHierarchy<Weight>::SearchUpward(int side, VertexId source, Visit visit) const {
+    SearchScratch& scratch = GetScratch();
+    scratch.Prepare(graph_.GetVertexCount());
+    std::vector<Weight>& weights = scratch.weights[side];
+    std::vector<uint32_t>& marks = scratch.marks[side];
+    const ArcLists& search_arcs = side == 0 ? upward_arcs_ : downward_arcs_;
+    const ArcLists& stall_arcs = side == 0 ? downward_arcs_ : upward_arcs_;
+
+    using QueueItem = std::pair<Weight, VertexId>;
+    std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> queue;
+    marks[source] = scratch.search_mark;
+    weights[source] = ZERO_WEIGHT;
+    queue.emplace(ZERO_WEIGHT, source);
+    while (!queue.empty()) {
+        const auto [weight, vertex] = queue.top();
+        queue.pop();
+        if (weight > weights[vertex]) {
+            continue;
+        }
+        // Вес остановленной вершины не кратчайший: ни в корзину, ни к корзинам она не нужна
+        const auto stall_range = stall_arcs.Get(vertex);
+        const bool stalled = std::any_of(stall_range.begin(), stall_range.end(), [&](const Arc& arc) {
+            return marks[arc.vertex] == scratch.search_mark && weights[arc.vertex] + arc.weight < weight;
+        });
+        if (stalled) {
+            continue;
+        }
+        visit(vertex, weight);
+        for (const Arc& arc : search_arcs.Get(vertex)) {
+            const Weight candidate_weight = weight + arc.weight;
+            if (marks[arc.vertex] != scratch.search_mark || candidate_weight < weights[arc.vertex]) {
+                marks[arc.vertex] = scratch.search_mark;
+                weights[arc.vertex] = candidate_weight;
+                queue.emplace(candidate_weight, arc.vertex);
+            }
+        }
+    }
+}
+
+template <typename Weight>
+std::vector<std::optional<Weight>> ContractionHierarchy<Weight>::BuildDistanceMatrix(const std::vector<VertexId>& sources,
+                                                                                     const std::vector<VertexId>& targets,
+                                                                                     size_t thread_count) const {
+    const size_t vertex_count = graph_.GetVertexCount();
+    const auto out_of_range = [vertex_count](VertexId vertex) {
+        return vertex >= vertex_count;
+    };
+    if (std::any_of(sources.begin(), sources.end(), out_of_range) || std::any_of(targets.begin(), targets.end(), out_of_range)) {
+        throw std::out_of_range("vertex is out of range");
+    }
+
+    std::vector<std::vector<std::pair<VertexId, Weight>>> target_spaces(targets.size());
+    parallel::ForEachChunk(targets.size(), thread_count, [&](size_t begin, size_t end) {
+        for (size_t target = begin; target < end; ++target) {
+            SearchUpward(1, targets[target], [&](VertexId vertex, Weight weight) {
+                target_spaces[target].emplace_back(vertex, weight);
+            });
+        }
+    });
+
+    // Корзины одним массивом: записи вершины v - bucket_entries[bucket_offsets[v]..bucket_offsets[v + 1])
+    std::vector<size_t> bucket_offsets(vertex_count + 1, 0);
+    for (const auto& space : target_spaces) {
+        for (const auto& [vertex, weight] : space) {
+            ++bucket_offsets[vertex + 1];
+        }
+    }
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        bucket_offsets[vertex + 1] += bucket_offsets[vertex];
+    }
+    std::vector<BucketEntry> bucket_entries(bucket_offsets.back());
+    std::vector<size_t> positions(bucket_offsets.begin(), bucket_offsets.end() - 1);
+    for (size_t target = 0; target < target_spaces.size(); ++target) {
+        for (const auto& [vertex, weight] : target_spaces[target]) {
+            bucket_entries[positions[vertex]++] = {target, weight};
+        }
+        std::vector<std::pair<VertexId, Weight>>().swap(target_spaces[target]);
+    }
+
+    std::vector<std::optional<Weight>> matrix(sources.size() * targets.size());
+    parallel::ForEachChunk(sources.size(), thread_count, [&](size_t begin, size_t end) {
+        for (size_t source = begin; source < end; ++source) {
+            std::optional<Weight>* row = matrix.data() + source * targets.size();
+            SearchUpward(0, sources[source], [&](VertexId vertex, Weight weight) {
+                for (size_t i = bucket_offsets[vertex]; i < bucket_offsets[vertex + 1]; ++i) {
+                    const BucketEntry& entry = bucket_entries[i];
+                    const Weight total_weight = weight + entry.weight;
+                    if (!row[entry.target] || total_weight < *row[entry.target]) {
+                        row[entry.target] = total_weight;
+                    }
+                }
+            });
+        }
+    });
+    return matrix;
+}
+
+}  // namespace graph
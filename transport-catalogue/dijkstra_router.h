@@ -0,0 +1,282 @@
+#pragma once
+
+#include "graph.h"
+#include "router.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+inline constexpr EdgeId NO_EDGE = static_cast<EdgeId>(-1);
+
+// Дерево кратчайших путей из одной вершины. prev_edges[v] - последнее ребро пути до v,
+// NO_TREE_EDGE у корня и у недостижимых вершин. Веса не хранятся: вес маршрута суммируется
+// по его ребрам в том же порядке, что и в поиске, поэтому совпадает с найденным поиском.
+// Так дерево занимает 4 байта на вершину и в кэш помещается вчетверо больше деревьев
+template <typename Weight>
+struct ShortestPathTree {
+    using RouteInfo = typename Router<Weight>::RouteInfo;
+    static constexpr uint32_t NO_TREE_EDGE = std::numeric_limits<uint32_t>::max();
+
+    VertexId root = 0;
+    std::vector<uint32_t> prev_edges;
+
+    bool IsReached(VertexId vertex) const {
+        return vertex == root || prev_edges[vertex] != NO_TREE_EDGE;
+    }
+
+    std::optional<RouteInfo> BuildRoute(VertexId to, const DirectedWeightedGraph<Weight>& graph) const {
+        if (!IsReached(to)) {
+            return std::nullopt;
+        }
+        std::vector<EdgeId> edges;
+        for (uint32_t edge_id = prev_edges[to]; edge_id != NO_TREE_EDGE; edge_id = prev_edges[graph.GetEdge(edge_id).from]) {
+            edges.push_back(edge_id);
+        }
+        std::reverse(edges.begin(), edges.end());
+        Weight weight{};
+        for (const EdgeId edge_id : edges) {
+            weight += graph.GetEdge(edge_id).weight;
+        }
+        return RouteInfo{weight, std::move(edges)};
+    }
+
+    size_t GetMemoryBytes() const {
+        return sizeof(ShortestPathTree) + prev_edges.capacity() * sizeof(uint32_t);
+    }
+
+    static size_t EstimateMemory(size_t vertex_count) {
+        return sizeof(ShortestPathTree) + vertex_count * sizeof(uint32_t);
+    }
+};
+
+// Маршрутизатор без предрасчета: каждый BuildRoute запускает Дейкстру от from.
+// Память O(V + E) вместо O(V^2) у Router, рабочие массивы переиспользуются в пределах потока.
+// Из равных путей выбирается тот же, что у Router: с меньшим последним ребром (для ребер положительного веса)
+template <typename Weight>
+class DijkstraRouter {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    using RouteInfo = typename Router<Weight>::RouteInfo;
+
+    DijkstraRouter() = default;
+    explicit DijkstraRouter(Graph graph);
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
+    // Маршруты из from во все targets одним поиском, который останавливается после извлечения всех целей
+    std::vector<std::optional<RouteInfo>> BuildRoutes(VertexId from, const std::vector<VertexId>& targets) const;
+    // Полный поиск из from без остановки на цели
+    ShortestPathTree<Weight> BuildShortestPathTree(VertexId from) const;
+    // Вершины замороженного graph, достижимые из from с весом не больше max_weight, с их весами,
+    // по возрастанию номера. Вершины дальше max_weight не раскрываются. Статический, чтобы работать
+    // по графу любого маршрутизатора
+    static std::vector<std::pair<VertexId, Weight>> FindReachable(const Graph& graph, VertexId from, Weight max_weight);
+
+    graph::DirectedWeightedGraph<Weight>& GetGraph() {
+        return graph_;
+    }
+
+    const graph::DirectedWeightedGraph<Weight>& GetGraph() const {
+        return graph_;
+    }
+
+private:
+    // Рабочие массивы одного потока. Вершина считается достигнутой в текущем поиске,
+    // только если ее метка совпадает с search_mark, поэтому между запросами массивы не очищаются
+    struct SearchScratch {
+        std::vector<Weight> weights;
+        std::vector<EdgeId> prev_edges;
+        std::vector<uint32_t> marks;
+        // Цели текущего поиска, еще не извлеченные из кучи, помечены search_mark
+        std::vector<uint32_t> target_marks;
+        std::vector<std::pair<Weight, VertexId>> heap;
+        uint32_t search_mark = 0;
+
+        void Prepare(size_t vertex_count) {
+            if (marks.size() < vertex_count) {
+                weights.resize(vertex_count);
+                prev_edges.resize(vertex_count);
+                marks.resize(vertex_count, 0);
+                target_marks.resize(vertex_count, 0);
+            }
+            heap.clear();
+            if (++search_mark == 0) {
+                std::fill(marks.begin(), marks.end(), 0);
+                std::fill(target_marks.begin(), target_marks.end(), 0);
+                search_mark = 1;
+            }
+        }
+
+        bool IsReached(VertexId vertex) const {
+            return marks[vertex] == search_mark;
+        }
+
+        void Reach(VertexId vertex, Weight weight, EdgeId prev_edge) {
+            marks[vertex] = search_mark;
+            weights[vertex] = weight;
+            prev_edges[vertex] = prev_edge;
+        }
+    };
+
+    static SearchScratch& GetScratch() {
+        static thread_local SearchScratch scratch;
+        return scratch;
+    }
+
+    // Дейкстра из from по graph, останавливается после извлечения всех целей [targets, targets + target_count).
+    // Без целей поиск полный. Пути тяжелее max_weight отбрасываются
+    static SearchScratch& Search(const Graph& graph, VertexId from, const VertexId* targets, size_t target_count,
+                                 Weight max_weight = MAX_WEIGHT);
+    std::optional<RouteInfo> ExtractRoute(const SearchScratch& scratch, VertexId to) const;
+
+    static constexpr Weight ZERO_WEIGHT{};
+    static constexpr Weight MAX_WEIGHT = std::numeric_limits<Weight>::max();
+    Graph graph_;
+};
+
+template <typename Weight>
+DijkstraRouter<Weight>::DijkstraRouter(Graph graph)
+    : graph_(std::move(graph))
+{
+    graph_.Freeze();
+    for (EdgeId edge_id = 0; edge_id < graph_.GetEdgeCount(); ++edge_id) {
+        if (graph_.GetEdge(edge_id).weight < ZERO_WEIGHT) {
+            throw std::domain_error("Edges' weights should be non-negative");
+        }
+    }
+}
+
+template <typename Weight>
+typename DijkstraRouter<Weight>::SearchScratch& DijkstraRouter<Weight>::Search(const Graph& graph, VertexId from,
+                                                                              const VertexId* targets, size_t target_count,
+                                                                              Weight max_weight) {
+    const size_t vertex_count = graph.GetVertexCount();
+    if (from >= vertex_count || std::any_of(targets, targets + target_count, [vertex_count](VertexId target) {
+            return target >= vertex_count;
+        })) {
+        throw std::out_of_range("vertex is out of range");
+    }
+
+    SearchScratch& scratch = GetScratch();
+    scratch.Prepare(vertex_count);
+    size_t remaining_targets = 0;
+    for (const VertexId* target = targets; target != targets + target_count; ++target) {
+        if (scratch.target_marks[*target] != scratch.search_mark) {
+            scratch.target_marks[*target] = scratch.search_mark;
+            ++remaining_targets;
+        }
+    }
+    auto& heap = scratch.heap;
+    const auto heap_compare = std::greater<std::pair<Weight, VertexId>>{};
+
+    scratch.Reach(from, ZERO_WEIGHT, NO_EDGE);
+    heap.emplace_back(ZERO_WEIGHT, from);
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), heap_compare);
+        const auto [weight, vertex] = heap.back();
+        heap.pop_back();
+        if (weight > scratch.weights[vertex]) {
+            continue;
+        }
+        if (scratch.target_marks[vertex] == scratch.search_mark) {
+            scratch.target_marks[vertex] = 0;
+            if (--remaining_targets == 0) {
+                break;
+            }
+        }
+        auto edge_id = graph.GetIncidentEdges(vertex).begin();
+        for (const auto& arc : graph.GetIncidentArcs(vertex)) {
+            const Weight candidate_weight = weight + arc.weight;
+            if (candidate_weight <= max_weight && (!scratch.IsReached(arc.to) || candidate_weight < scratch.weights[arc.to])) {
+                scratch.Reach(arc.to, candidate_weight, *edge_id);
+                heap.emplace_back(candidate_weight, arc.to);
+                std::push_heap(heap.begin(), heap.end(), heap_compare);
+            } else if (scratch.IsReached(arc.to) && candidate_weight == scratch.weights[arc.to]
+                       && *edge_id < scratch.prev_edges[arc.to] && arc.weight > ZERO_WEIGHT) {
+                // Равный путь с меньшим последним ребром, как в Router. При положительном весе дуги
+                // vertex извлекается раньше arc.to, поэтому до извлечения цели учтены все такие пути
+                scratch.prev_edges[arc.to] = *edge_id;
+            }
+            ++edge_id;
+        }
+    }
+    return scratch;
+}
+
+template <typename Weight>
+std::optional<typename DijkstraRouter<Weight>::RouteInfo> DijkstraRouter<Weight>::ExtractRoute(const SearchScratch& scratch,
+                                                                                               VertexId to) const {
+    if (!scratch.IsReached(to)) {
+        return std::nullopt;
+    }
+    std::vector<EdgeId> edges;
+    for (EdgeId edge_id = scratch.prev_edges[to]; edge_id != NO_EDGE;
+         edge_id = scratch.prev_edges[graph_.GetEdge(edge_id).from])
+    {
+        edges.push_back(edge_id);
+    }
+    std::reverse(edges.begin(), edges.end());
+
+    return RouteInfo{scratch.weights[to], std::move(edges)};
+}
+
+template <typename Weight>
+std::optional<typename DijkstraRouter<Weight>::RouteInfo> DijkstraRouter<Weight>::BuildRoute(VertexId from,
+                                                                                             VertexId to) const {
+    return ExtractRoute(Search(graph_, from, &to, 1), to);
+}
+
+template <typename Weight>
+std::vector<std::optional<typename DijkstraRouter<Weight>::RouteInfo>> DijkstraRouter<Weight>::BuildRoutes(
+    VertexId from, const std::vector<VertexId>& targets) const {
+    const SearchScratch& scratch = Search(graph_, from, targets.data(), targets.size());
+    std::vector<std::optional<RouteInfo>> routes;
+    routes.reserve(targets.size());
+    for (const VertexId to : targets) {
+        routes.push_back(ExtractRoute(scratch, to));
+    }
+    return routes;
+}
+
+template <typename Weight>
+ShortestPathTree<Weight> DijkstraRouter<Weight>::BuildShortestPathTree(VertexId from) const {
+    const SearchScratch& scratch = Search(graph_, from, nullptr, 0);
+    const size_t vertex_count = graph_.GetVertexCount();
+
+    ShortestPathTree<Weight> tree;
+    tree.root = from;
+    tree.prev_edges.assign(vertex_count, ShortestPathTree<Weight>::NO_TREE_EDGE);
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        if (scratch.IsReached(vertex) && scratch.prev_edges[vertex] != NO_EDGE) {
+            tree.prev_edges[vertex] = static_cast<uint32_t>(scratch.prev_edges[vertex]);
+        }
+    }
+    return tree;
+}
+
+template <typename Weight>
+std::vector<std::pair<VertexId, Weight>> DijkstraRouter<Weight>::FindReachable(const Graph& graph, VertexId from, Weight max_weight) {
+    if (max_weight < ZERO_WEIGHT) {
+        return {};
+    }
+    // Поиск без целей извлекает все вершины в пределах max_weight: дальние в кучу не попадают
+    const SearchScratch& scratch = Search(graph, from, nullptr, 0, max_weight);
+    std::vector<std::pair<VertexId, Weight>> reachable;
+    for (VertexId vertex = 0; vertex < graph.GetVertexCount(); ++vertex) {
+        if (scratch.IsReached(vertex)) {
+            reachable.emplace_back(vertex, scratch.weights[vertex]);
+        }
+    }
+    return reachable;
+}
+
+}  // namespace graph
@@ -1,5 +1,6 @@
 #include "domain.h"
 
+#include <algorithm>
 #include <tuple>
 
 size_t Stop::operator()(const Stop& stop) const {
@@ -18,6 +19,13 @@ bool Bus::operator==(const Bus& bus) const{
     return bus.name == name && std::equal(stops.begin(), stops.end(), bus.stops.begin(), bus.stops.end());
 }
 
+int Bus::GetRoadDistance(size_t from, size_t to) const{
+    if(from <= to){
+        return forward_distances[to] - forward_distances[from];
+    }
+    return backward_distances[from] - backward_distances[to];
+}
+
 bool BusInfo::operator==(const BusInfo& info){
     return std::tie(info.length, info.stops_route, info.unique_stops) == std::tie(length, stops_route, unique_stops);
 }
\ No newline at end of file
@@ -2,12 +2,18 @@
 
 #include "geo.h"
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
+// Плотные идентификаторы, которые справочник выдает при добавлении
+using StopId = uint32_t;
+using BusId = uint32_t;
+
 struct Stop {
     std::string name;
     geo::Coordinates coordinates;
+    StopId id;
 
     size_t operator()(const Stop& stop) const;
 
@@ -18,9 +24,18 @@ struct Bus {
     std::string name;
     std::vector<const Stop*> stops;
     bool is_round;
+    BusId id;
+    // Накопленные дорожные расстояния от начала маршрута: forward_distances[i] - при
+    // движении по порядку остановок, backward_distances[i] - при движении в обратную сторону.
+    // Заполняются справочником в Finalize
+    std::vector<int> forward_distances;
+    std::vector<int> backward_distances;
 
     size_t operator()(const Bus* bus) const;
 
+    // Дорожное расстояние между позициями маршрута, from > to - движение в обратную сторону
+    int GetRoadDistance(size_t from, size_t to) const;
+
     bool operator==(const Bus& bus) const;
 };
 
@@ -2,7 +2,15 @@
 
 #include "ranges.h"
 
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
 #include <cstdlib>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <utility>
 #include <vector>
 
 namespace graph {
@@ -19,61 +27,327 @@ struct Edge {
     Edge(VertexId from_, VertexId to_, Weight weight_) : from(from_), to(to_), weight(weight_){}
 };
 
+// Исходящая дуга замороженного графа: конец и вес ребра
+template <typename Weight>
+struct IncidentArc {
+    VertexId to;
+    Weight weight;
+};
+
+// Дуги строки замороженного графа: концы и веса лежат в отдельных массивах и читаются подряд
+template <typename Weight>
+class IncidentArcIterator {
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = IncidentArc<Weight>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = IncidentArc<Weight>;
+
+    IncidentArcIterator(const uint32_t* target, const Weight* weight) : target_(target), weight_(weight) {}
+
+    IncidentArc<Weight> operator*() const {
+        return {*target_, *weight_};
+    }
+    IncidentArcIterator& operator++() {
+        ++target_;
+        ++weight_;
+        return *this;
+    }
+    bool operator==(const IncidentArcIterator& other) const {
+        return target_ == other.target_;
+    }
+    bool operator!=(const IncidentArcIterator& other) const {
+        return target_ != other.target_;
+    }
+
+private:
+    const uint32_t* target_;
+    const Weight* weight_;
+};
+
+// Граф строится добавлением ребер в списки инцидентности. Freeze переводит его в сжатые строки
+// (CSR): 32-битные смещения по вершинам и массивы начал, концов и весов ребер, отсортированные
+// по началу с сохранением порядка EdgeId внутри вершины. Сами EdgeId при этом не меняются:
+// EdgeId каждой позиции и позиция каждого EdgeId хранятся рядом, и GetEdge собирает ребро
+// из строк, отдельной копии ребер нет. Граф из готового списка ребер сразу строится замороженным
 template <typename Weight>
 class DirectedWeightedGraph {
 private:
-    using IncidenceList = std::vector<EdgeId>;
-    using IncidentEdgesRange = ranges::Range<typename IncidenceList::const_iterator>;
+    using IncidenceList = std::vector<uint32_t>;
+    using IncidentEdgesRange = ranges::Range<const uint32_t*>;
+    using IncidentArcsRange = ranges::Range<IncidentArcIterator<Weight>>;
 
 public:
     DirectedWeightedGraph() = default;
     explicit DirectedWeightedGraph(size_t vertex_count);
+    // Граф из готового списка ребер: EdgeId ребра - его индекс в edges
+    DirectedWeightedGraph(size_t vertex_count, std::vector<Edge<Weight>> edges);
     EdgeId AddEdge(const Edge<Weight>& edge);
+    // Добавляет ребра и в замороженный граф: новые ребра дописываются в конец строк своих начал,
+    // остальные строки сдвигаются целиком, без пересборки. EdgeId новых ребер больше прежних,
+    // поэтому порядок внутри строк сохраняется. Возвращает EdgeId первого добавленного ребра, остальные идут подряд
+    EdgeId AppendEdges(const std::vector<Edge<Weight>>& edges);
+    void Freeze();
 
     size_t GetVertexCount() const;
     size_t GetEdgeCount() const;
-    const Edge<Weight>& GetEdge(EdgeId edge_id) const;
+    bool IsFrozen() const;
+    // Доступ без проверки границ для горячих циклов маршрутизаторов
+    Edge<Weight> GetEdge(EdgeId edge_id) const;
     IncidentEdgesRange GetIncidentEdges(VertexId vertex) const;
+    // Только для замороженного графа: i-я дуга соответствует i-му ребру GetIncidentEdges
+    IncidentArcsRange GetIncidentArcs(VertexId vertex) const;
+    size_t GetMemoryBytes() const;
 
-    const Edge<Weight>& FindEdge(EdgeId id) const{
-        return edges_.at(id);
+    Edge<Weight> FindEdge(EdgeId id) const{
+        if (id >= GetEdgeCount()) {
+            throw std::out_of_range("edge is out of range");
+        }
+        return GetEdge(id);
     }
 
+private:
+    // Оба конца ребра - вершины графа, иначе std::out_of_range
+    void CheckEdge(const Edge<Weight>& edge) const;
+    // Строки из edges_; сами ребра после этого хранятся только в строках
+    void BuildIncidenceArrays();
+
+    size_t vertex_count_ = 0;
+    size_t edge_count_ = 0;
+    // Ребра незамороженного графа по EdgeId и списки EdgeId по началам
     std::vector<Edge<Weight>> edges_;
     std::vector<IncidenceList> incidence_lists_;
+    // Ребра вершины v - позиции incidence_offsets_[v]..incidence_offsets_[v + 1]
+    std::vector<uint32_t> incidence_offsets_;
+    std::vector<uint32_t> sources_;
+    std::vector<uint32_t> targets_;
+    std::vector<Weight> weights_;
+    // EdgeId ребра в каждой позиции и позиция каждого EdgeId
+    std::vector<uint32_t> incident_edges_;
+    std::vector<uint32_t> edge_positions_;
 };
 
 template <typename Weight>
 DirectedWeightedGraph<Weight>::DirectedWeightedGraph(size_t vertex_count)
-    : incidence_lists_(vertex_count) {
+    : vertex_count_(vertex_count)
+    , incidence_lists_(vertex_count) {
+}
+
+template <typename Weight>
+DirectedWeightedGraph<Weight>::DirectedWeightedGraph(size_t vertex_count, std::vector<Edge<Weight>> edges)
+    : vertex_count_(vertex_count)
+    , edge_count_(edges.size())
+    , edges_(std::move(edges)) {
+    BuildIncidenceArrays();
+}
+
+template <typename Weight>
+void DirectedWeightedGraph<Weight>::CheckEdge(const Edge<Weight>& edge) const {
+    if (edge.from >= vertex_count_) {
+        throw std::out_of_range("edge starts outside the graph");
+    }
+    if (edge.to >= vertex_count_) {
+        throw std::out_of_range("edge ends outside the graph");
+    }
 }
 
 template <typename Weight>
 EdgeId DirectedWeightedGraph<Weight>::AddEdge(const Edge<Weight>& edge) {
+    if (IsFrozen()) {
+        throw std::logic_error("Cannot add an edge to a frozen graph");
+    }
+    CheckEdge(edge);
+    if (edge_count_ >= std::numeric_limits<uint32_t>::max()) {
+        throw std::length_error("Too many edges for 32-bit edge ids");
+    }
     edges_.push_back(edge);
-    const EdgeId id = edges_.size() - 1;
-    incidence_lists_.at(edge.from).push_back(id);
+    const EdgeId id = edge_count_++;
+    incidence_lists_[edge.from].push_back(static_cast<uint32_t>(id));
     return id;
 }
 
+template <typename Weight>
+EdgeId DirectedWeightedGraph<Weight>::AppendEdges(const std::vector<Edge<Weight>>& edges) {
+    const EdgeId first_id = edge_count_;
+    if (edges.empty()) {
+        return first_id;
+    }
+    // Ребра проверяются до добавления, чтобы при ошибке граф остался прежним
+    for (const auto& edge : edges) {
+        CheckEdge(edge);
+    }
+    if (edges.size() >= std::numeric_limits<uint32_t>::max() - edge_count_) {
+        throw std::length_error("Too many edges for 32-bit edge ids");
+    }
+    if (!IsFrozen()) {
+        for (const auto& edge : edges) {
+            AddEdge(edge);
+        }
+        return first_id;
+    }
+    // Новые ребра по началам: в строке - по возрастанию EdgeId
+    std::vector<std::pair<VertexId, EdgeId>> added;
+    added.reserve(edges.size());
+    for (const auto& edge : edges) {
+        added.emplace_back(edge.from, first_id + added.size());
+    }
+    std::stable_sort(added.begin(), added.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.first < rhs.first;
+    });
+    edge_count_ += edges.size();
+
+    // С конца: хвост после строки сдвигается на число ребер, которые добавятся в нее и раньше,
+    // новые ребра встают в конец своей строки
+    const auto shift_tail = [](auto& values, size_t row_end, size_t read_end, size_t write_end) {
+        std::move_backward(values.begin() + row_end, values.begin() + read_end, values.begin() + write_end);
+    };
+    const size_t first_changed = incidence_offsets_[added.front().first];
+    size_t read_end = sources_.size();
+    sources_.resize(edge_count_);
+    targets_.resize(edge_count_);
+    weights_.resize(edge_count_);
+    incident_edges_.resize(edge_count_);
+    edge_positions_.resize(edge_count_);
+    size_t write_end = edge_count_;
+    for (auto group_end = added.end(); group_end != added.begin();) {
+        const VertexId vertex = std::prev(group_end)->first;
+        auto group_begin = std::prev(group_end);
+        while (group_begin != added.begin() && std::prev(group_begin)->first == vertex) {
+            --group_begin;
+        }
+        const size_t row_end = incidence_offsets_[vertex + 1];
+        shift_tail(sources_, row_end, read_end, write_end);
+        shift_tail(targets_, row_end, read_end, write_end);
+        shift_tail(weights_, row_end, read_end, write_end);
+        shift_tail(incident_edges_, row_end, read_end, write_end);
+        write_end -= read_end - row_end;
+        read_end = row_end;
+        write_end -= group_end - group_begin;
+        size_t position = write_end;
+        for (auto it = group_begin; it != group_end; ++it) {
+            const auto& edge = edges[it->second - first_id];
+            sources_[position] = static_cast<uint32_t>(edge.from);
+            targets_[position] = static_cast<uint32_t>(edge.to);
+            weights_[position] = edge.weight;
+            incident_edges_[position] = static_cast<uint32_t>(it->second);
+            ++position;
+        }
+        group_end = group_begin;
+    }
+    for (size_t position = first_changed; position < edge_count_; ++position) {
+        edge_positions_[incident_edges_[position]] = static_cast<uint32_t>(position);
+    }
+
+    // Смещения меняются только начиная с первой строки с новыми ребрами
+    uint32_t shift = 0;
+    auto it = added.begin();
+    for (VertexId vertex = added.front().first; vertex < vertex_count_; ++vertex) {
+        while (it != added.end() && it->first == vertex) {
+            ++shift;
+            ++it;
+        }
+        incidence_offsets_[vertex + 1] += shift;
+    }
+    return first_id;
+}
+
+template <typename Weight>
+void DirectedWeightedGraph<Weight>::Freeze() {
+    if (IsFrozen()) {
+        return;
+    }
+    BuildIncidenceArrays();
+    std::vector<IncidenceList>().swap(incidence_lists_);
+}
+
+// Сортировка подсчетом: проход степеней, префиксные суммы, раскладка ребер по возрастанию EdgeId
+template <typename Weight>
+void DirectedWeightedGraph<Weight>::BuildIncidenceArrays() {
+    if (edge_count_ >= std::numeric_limits<uint32_t>::max() || vertex_count_ >= std::numeric_limits<uint32_t>::max()) {
+        throw std::length_error("Graph is too large for 32-bit offsets");
+    }
+    incidence_offsets_.assign(vertex_count_ + 1, 0);
+    for (const auto& edge : edges_) {
+        CheckEdge(edge);
+        ++incidence_offsets_[edge.from + 1];
+    }
+    for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) {
+        incidence_offsets_[vertex + 1] += incidence_offsets_[vertex];
+    }
+    std::vector<uint32_t> positions(incidence_offsets_.begin(), incidence_offsets_.end() - 1);
+    sources_.resize(edge_count_);
+    targets_.resize(edge_count_);
+    weights_.resize(edge_count_);
+    incident_edges_.resize(edge_count_);
+    edge_positions_.resize(edge_count_);
+    for (EdgeId id = 0; id < edge_count_; ++id) {
+        const auto& edge = edges_[id];
+        const uint32_t position = positions[edge.from]++;
+        sources_[position] = static_cast<uint32_t>(edge.from);
+        targets_[position] = static_cast<uint32_t>(edge.to);
+        weights_[position] = edge.weight;
+        incident_edges_[position] = static_cast<uint32_t>(id);
+        edge_positions_[id] = position;
+    }
+    std::vector<Edge<Weight>>().swap(edges_);
+}
+
 template <typename Weight>
 size_t DirectedWeightedGraph<Weight>::GetVertexCount() const {
-    return incidence_lists_.size();
+    return vertex_count_;
 }
 
 template <typename Weight>
 size_t DirectedWeightedGraph<Weight>::GetEdgeCount() const {
-    return edges_.size();
+    return edge_count_;
 }
 
 template <typename Weight>
-const Edge<Weight>& DirectedWeightedGraph<Weight>::GetEdge(EdgeId edge_id) const {
-    return edges_.at(edge_id);
+bool DirectedWeightedGraph<Weight>::IsFrozen() const {
+    return !incidence_offsets_.empty();
+}
+
+template <typename Weight>
+Edge<Weight> DirectedWeightedGraph<Weight>::GetEdge(EdgeId edge_id) const {
+    assert(edge_id < edge_count_);
+    if (!IsFrozen()) {
+        return edges_[edge_id];
+    }
+    const uint32_t position = edge_positions_[edge_id];
+    return {sources_[position], targets_[position], weights_[position]};
 }
 
 template <typename Weight>
 typename DirectedWeightedGraph<Weight>::IncidentEdgesRange
 DirectedWeightedGraph<Weight>::GetIncidentEdges(VertexId vertex) const {
-    return ranges::AsRange(incidence_lists_.at(vertex));
+    assert(vertex < vertex_count_);
+    if (!IsFrozen()) {
+        const IncidenceList& list = incidence_lists_[vertex];
+        return {list.data(), list.data() + list.size()};
+    }
+    return {incident_edges_.data() + incidence_offsets_[vertex], incident_edges_.data() + incidence_offsets_[vertex + 1]};
+}
+
+template <typename Weight>
+typename DirectedWeightedGraph<Weight>::IncidentArcsRange
+DirectedWeightedGraph<Weight>::GetIncidentArcs(VertexId vertex) const {
+    assert(IsFrozen() && vertex < vertex_count_);
+    const uint32_t begin = incidence_offsets_[vertex];
+    const uint32_t end = incidence_offsets_[vertex + 1];
+    return {{targets_.data() + begin, weights_.data() + begin}, {targets_.data() + end, weights_.data() + end}};
+}
+
+template <typename Weight>
+size_t DirectedWeightedGraph<Weight>::GetMemoryBytes() const {
+    size_t bytes = edges_.capacity() * sizeof(Edge<Weight>)
+                   + (incidence_offsets_.capacity() + sources_.capacity() + targets_.capacity()) * sizeof(uint32_t)
+                   + weights_.capacity() * sizeof(Weight)
+                   + (incident_edges_.capacity() + edge_positions_.capacity()) * sizeof(uint32_t)
+                   + incidence_lists_.capacity() * sizeof(IncidenceList);
+    for (const IncidenceList& list : incidence_lists_) {
+        bytes += list.capacity() * sizeof(uint32_t);
+    }
+    return bytes;
 }
-}  // namespace graph
\ No newline at end of file
+}  // namespace graph
@@ -0,0 +1,438 @@
+#pragma once
+
+#include "graph.h"
+#include "parallel.h"
+#include "router.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// Двухуровневые метки (hub labeling), построенные pruned landmark labeling. Вершины-хабы
+// обрабатываются по убыванию важности, от каждого идут прямой и обратный поиски Дейкстры,
+// которые не продолжаются из вершин, расстояние до которых уже покрыто прежними метками.
+// Запрос - слияние двух отсортированных по хабам списков, путь восстанавливается по ребрам-подсказкам.
+// Из равных путей при положительных весах выбирается тот же, что у Router: с наименьшим последним ребром
+template <typename Weight>
+class HubLabelRouter {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    using RouteInfo = typename Router<Weight>::RouteInfo;
+
+    // hub - ранг хаба. У входящей метки вершины v parent_edge - последнее ребро пути hub -> v,
+    // у исходящей - первое ребро пути v -> hub; у самого хаба ребра нет
+    struct LabelEntry {
+        uint32_t hub;
+        EdgeId parent_edge;
+        Weight weight;
+    };
+
+    HubLabelRouter() = default;
+    // thread_count - число потоков построения, метки от него не зависят
+    explicit HubLabelRouter(Graph graph, size_t thread_count = 1);
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
+
+    size_t GetLabelCount() const {
+        return in_entries_.size() + out_entries_.size();
+    }
+
+    size_t GetIndexBytes() const {
+        return (in_entries_.size() + out_entries_.size()) * sizeof(LabelEntry)
+               + (in_offsets_.size() + out_offsets_.size() + in_edge_offsets_.size()) * sizeof(size_t)
+               + in_edges_.size() * sizeof(EdgeId);
+    }
+
+    // Метки вершины по возрастанию ранга хаба
+    ranges::Range<const LabelEntry*> GetInLabel(VertexId vertex) const {
+        return {in_entries_.data() + in_offsets_[vertex], in_entries_.data() + in_offsets_[vertex + 1]};
+    }
+
+    ranges::Range<const LabelEntry*> GetOutLabel(VertexId vertex) const {
+        return {out_entries_.data() + out_offsets_[vertex], out_entries_.data() + out_offsets_[vertex + 1]};
+    }
+
+    graph::DirectedWeightedGraph<Weight>& GetGraph() {
+        return graph_;
+    }
+
+    const graph::DirectedWeightedGraph<Weight>& GetGraph() const {
+        return graph_;
+    }
+
+private:
+    using Labels = std::vector<std::vector<LabelEntry>>;
+
+    // Найденные одним поиском метки: вершина и ее новая запись
+    using SearchResult = std::vector<std::pair<VertexId, LabelEntry>>;
+
+    static constexpr EdgeId NO_PARENT_EDGE = std::numeric_limits<EdgeId>::max();
+    // Хабы одной пачки ищутся параллельно и отсекаются только метками прежних пачек.
+    // Первые хабы отсекают больше всего, поэтому пачки растут вместе с числом готовых хабов,
+    // и их границы не зависят от числа потоков
+    static constexpr size_t BATCH_DIVISOR = 8;
+    static constexpr size_t MAX_BATCH_SIZE = 64;
+    // Число корней деревьев кратчайших путей, по которым выбирается порядок хабов
+    static constexpr size_t SAMPLE_COUNT = 256;
+
+    struct SearchScratch {
+        std::vector<Weight> weights;
+        std::vector<EdgeId> parent_edges;
+        std::vector<uint32_t> marks;
+        uint32_t search_mark = 0;
+        // Метка корня поиска, разложенная по рангам хабов
+        std::vector<Weight> root_weights;
+        std::vector<uint32_t> root_marks;
+        std::vector<std::pair<Weight, VertexId>> heap;
+
+        void Prepare(size_t vertex_count) {
+            if (marks.size() < vertex_count) {
+                weights.resize(vertex_count);
+                parent_edges.resize(vertex_count);
+                marks.resize(vertex_count, 0);
+                root_weights.resize(vertex_count);
+                root_marks.resize(vertex_count, 0);
+            }
+            heap.clear();
+            if (++search_mark == 0) {
+                std::fill(marks.begin(), marks.end(), 0);
+                std::fill(root_marks.begin(), root_marks.end(), 0);
+                search_mark = 1;
+            }
+        }
+    };
+
+    static SearchScratch& GetScratch() {
+        static thread_local SearchScratch scratch;
+        return scratch;
+    }
+
+    // Отсекаемый поиск от хаба ранга hub_rank: прямой по исходящим ребрам находит входящие метки,
+    // обратный по ребрам reverse_graph - исходящие. У ребер reverse_graph те же EdgeId, что в graph_
+    SearchResult PrunedSearch(uint32_t hub_rank, bool forward, const Labels& in_labels, const Labels& out_labels,
+                              const Graph& reverse_graph) const;
+    static void Flatten(Labels& labels, std::vector<size_t>& offsets, std::vector<LabelEntry>& entries);
+    const LabelEntry& FindEntry(const std::vector<size_t>& offsets, const std::vector<LabelEntry>& entries,
+                                VertexId vertex, uint32_t hub) const;
+
+    static constexpr Weight ZERO_WEIGHT{};
+    Graph graph_;
+    std::vector<VertexId> hubs_;
+    // Метки вершины v - записи [offsets[v], offsets[v + 1]), отсортированные по рангу хаба
+    std::vector<size_t> in_offsets_;
+    std::vector<LabelEntry> in_entries_;
+    std::vector<size_t> out_offsets_;
+    std::vector<LabelEntry> out_entries_;
+    // Входящие ребра: в vertex - in_edges_[in_edge_offsets_[vertex]..in_edge_offsets_[vertex + 1]), по возрастанию EdgeId
+    std::vector<size_t> in_edge_offsets_;
+    std::vector<EdgeId> in_edges_;
+    // С ребрами нулевого веса путь не уточняется: равных путей может быть сколько угодно длинных
+    bool has_zero_weight_ = false;
+};
+
+template <typename Weight>
+HubLabelRouter<Weight>::HubLabelRouter(Graph graph, size_t thread_count)
+    : graph_(std::move(graph))
+{
+    graph_.Freeze();
+    const size_t vertex_count = graph_.GetVertexCount();
+    std::vector<Edge<Weight>> reverse_edges;
+    reverse_edges.reserve(graph_.GetEdgeCount());
+    for (EdgeId edge_id = 0; edge_id < graph_.GetEdgeCount(); ++edge_id) {
+        const auto& edge = graph_.GetEdge(edge_id);
+        if (edge.weight < ZERO_WEIGHT) {
+            throw std::domain_error("Edges' weights should be non-negative");
+        }
+        has_zero_weight_ = has_zero_weight_ || edge.weight == ZERO_WEIGHT;
+        reverse_edges.emplace_back(edge.to, edge.from, edge.weight);
+    }
+    const Graph reverse_graph(vertex_count, std::move(reverse_edges));
+    // Ребра обратного графа добавлены по порядку EdgeId, поэтому его списки - входящие ребра по возрастанию
+    in_edge_offsets_.assign(vertex_count + 1, 0);
+    in_edges_.reserve(graph_.GetEdgeCount());
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        const auto vertex_edges = reverse_graph.GetIncidentEdges(vertex);
+        in_edges_.insert(in_edges_.end(), vertex_edges.begin(), vertex_edges.end());
+        in_edge_offsets_[vertex + 1] = in_edges_.size();
+    }
+
+    // Важность вершины - сколько вершин лежит под ней в деревьях кратчайших путей из нескольких
+    // равномерно выбранных корней: такие вершины покрывают больше путей и должны стать хабами раньше.
+    // Деревья строятся тем же поиском без отсечения, пока hubs_ - тождественный порядок.
+    // При равенстве выше вершина с меньшим номером
+    hubs_.resize(vertex_count);
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        hubs_[vertex] = vertex;
+    }
+    std::vector<size_t> importance(vertex_count, 0);
+    const Labels empty_labels(vertex_count);
+    const size_t sample_count = std::min(SAMPLE_COUNT, vertex_count);
+    std::vector<SearchResult> trees(2 * sample_count);
+    parallel::ForEachChunk(trees.size(), thread_count, [&](size_t begin, size_t end) {
+        for (size_t task = begin; task < end; ++task) {
+            const auto root = static_cast<uint32_t>(task % sample_count * vertex_count / sample_count);
+            trees[task] = PrunedSearch(root, task < sample_count, empty_labels, empty_labels, reverse_graph);
+        }
+    });
+    std::vector<size_t> subtree_sizes(vertex_count);
+    for (size_t task = 0; task < trees.size(); ++task) {
+        const SearchResult& tree = trees[task];
+        // Вершины идут в порядке извлечения, поэтому потомки обходятся раньше предков
+        for (const auto& [vertex, entry] : tree) {
+            subtree_sizes[vertex] = 1;
+        }
+        for (auto it = tree.rbegin(); it != tree.rend(); ++it) {
+            const auto& [vertex, entry] = *it;
+            importance[vertex] += subtree_sizes[vertex];
+            if (entry.parent_edge != NO_PARENT_EDGE) {
+                const auto& edge = graph_.GetEdge(entry.parent_edge);
+                subtree_sizes[task < sample_count ? edge.from : edge.to] += subtree_sizes[vertex];
+            }
+        }
+    }
+    std::stable_sort(hubs_.begin(), hubs_.end(), [&](VertexId lhs, VertexId rhs) {
+        return importance[lhs] > importance[rhs];
+    });
+
+    Labels in_labels(vertex_count);
+    Labels out_labels(vertex_count);
+    parallel::WorkerPool pool(thread_count);
+    for (size_t batch_begin = 0; batch_begin < vertex_count;) {
+        const size_t batch_size = std::min({MAX_BATCH_SIZE, std::max<size_t>(1, batch_begin / BATCH_DIVISOR),
+                                            vertex_count - batch_begin});
+        // Задача i < batch_size - прямой поиск от хаба batch_begin + i, остальные - обратные
+        std::vector<SearchResult> results(2 * batch_size);
+        pool.ForEachChunk(results.size(), [&](size_t begin, size_t end) {
+            for (size_t task = begin; task < end; ++task) {
+                const auto hub_rank = static_cast<uint32_t>(batch_begin + task % batch_size);
+                results[task] = PrunedSearch(hub_rank, task < batch_size, in_labels, out_labels, reverse_graph);
+            }
+        });
+        for (size_t task = 0; task < results.size(); ++task) {
+            Labels& labels = task < batch_size ? in_labels : out_labels;
+            for (const auto& [vertex, entry] : results[task]) {
+                labels[vertex].push_back(entry);
+            }
+        }
+        // Результаты добавляются по возрастанию ранга, поэтому списки меток остаются отсортированными
+        batch_begin += batch_size;
+    }
+
+    Flatten(in_labels, in_offsets_, in_entries_);
+    Flatten(out_labels, out_offsets_, out_entries_);
+}
+
+template <typename Weight>
+typename HubLabelRouter<Weight>::SearchResult HubLabelRouter<Weight>::PrunedSearch(
+    uint32_t hub_rank, bool forward, const Labels& in_labels, const Labels& out_labels,
+    const Graph& reverse_graph) const {
+    const size_t vertex_count = graph_.GetVertexCount();
+    const VertexId hub = hubs_[hub_rank];
+    // Прямой поиск проверяет покрытие hub -> v по исходящим меткам хаба и входящим меткам v,
+    // обратный - v -> hub по входящим меткам хаба и исходящим меткам v
+    const Labels& root_labels = forward ? out_labels : in_labels;
+    const Labels& vertex_labels = forward ? in_labels : out_labels;
+    const Graph& search_graph = forward ? graph_ : reverse_graph;
+
+    SearchScratch& scratch = GetScratch();
+    scratch.Prepare(vertex_count);
+    for (const LabelEntry& entry : root_labels[hub]) {
+        scratch.root_marks[entry.hub] = scratch.search_mark;
+        scratch.root_weights[entry.hub] = entry.weight;
+    }
+    const auto is_covered = [&](VertexId vertex, Weight weight) {
+        for (const LabelEntry& entry : vertex_labels[vertex]) {
+            if (scratch.root_marks[entry.hub] == scratch.search_mark
+                && scratch.root_weights[entry.hub] + entry.weight <= weight) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    SearchResult result;
+    auto& heap = scratch.heap;
+    const auto heap_compare = std::greater<std::pair<Weight, VertexId>>{};
+    scratch.marks[hub] = scratch.search_mark;
+    scratch.weights[hub] = ZERO_WEIGHT;
+    scratch.parent_edges[hub] = NO_PARENT_EDGE;
+    heap.emplace_back(ZERO_WEIGHT, hub);
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), heap_compare);
+        const auto [weight, vertex] = heap.back();
+        heap.pop_back();
+        if (weight > scratch.weights[vertex] || is_covered(vertex, weight)) {
+            continue;
+        }
+        result.emplace_back(vertex, LabelEntry{hub_rank, scratch.parent_edges[vertex], weight});
+
+        auto edge_id = search_graph.GetIncidentEdges(vertex).begin();
+        for (const auto& arc : search_graph.GetIncidentArcs(vertex)) {
+            const Weight candidate_weight = weight + arc.weight;
+            if (scratch.marks[arc.to] != scratch.search_mark || candidate_weight < scratch.weights[arc.to]) {
+                scratch.marks[arc.to] = scratch.search_mark;
+                scratch.weights[arc.to] = candidate_weight;
+                scratch.parent_edges[arc.to] = *edge_id;
+                heap.emplace_back(candidate_weight, arc.to);
+                std::push_heap(heap.begin(), heap.end(), heap_compare);
+            }
+            ++edge_id;
+        }
+    }
+    return result;
+}
+
+template <typename Weight>
+void HubLabelRouter<Weight>::Flatten(Labels& labels, std::vector<size_t>& offsets, std::vector<LabelEntry>& entries) {
+    offsets.assign(labels.size() + 1, 0);
+    for (size_t vertex = 0; vertex < labels.size(); ++vertex) {
+        offsets[vertex + 1] = offsets[vertex] + labels[vertex].size();
+    }
+    entries.clear();
+    entries.reserve(offsets.back());
+    for (auto& vertex_labels : labels) {
+        entries.insert(entries.end(), vertex_labels.begin(), vertex_labels.end());
+        std::vector<LabelEntry>().swap(vertex_labels);
+    }
+}
+
+template <typename Weight>
+const typename HubLabelRouter<Weight>::LabelEntry& HubLabelRouter<Weight>::FindEntry(
+    const std::vector<size_t>& offsets, const std::vector<LabelEntry>& entries, VertexId vertex, uint32_t hub) const {
+    const auto begin = entries.begin() + offsets[vertex];
+    const auto end = entries.begin() + offsets[vertex + 1];
+    const auto it = std::lower_bound(begin, end, hub, [](const LabelEntry& entry, uint32_t value) {
+        return entry.hub < value;
+    });
+    if (it == end || it->hub != hub) {
+        throw std::logic_error("hub label chain is broken");
+    }
+    return *it;
+}
+
+template <typename Weight>
+std::optional<typename HubLabelRouter<Weight>::RouteInfo> HubLabelRouter<Weight>::BuildRoute(VertexId from,
+                                                                                             VertexId to) const {
+    const size_t vertex_count = graph_.GetVertexCount();
+    if (from >= vertex_count || to >= vertex_count) {
+        throw std::out_of_range("vertex is out of range");
+    }
+
+    // Слияние исходящих меток from и входящих меток to по рангу хаба
+    std::optional<Weight> best_weight;
+    uint32_t best_hub = 0;
+    size_t out_index = out_offsets_[from];
+    size_t in_index = in_offsets_[to];
+    const size_t out_end = out_offsets_[from + 1];
+    const size_t in_end = in_offsets_[to + 1];
+    while (out_index < out_end && in_index < in_end) {
+        const LabelEntry& out_entry = out_entries_[out_index];
+        const LabelEntry& in_entry = in_entries_[in_index];
+        if (out_entry.hub < in_entry.hub) {
+            ++out_index;
+        } else if (in_entry.hub < out_entry.hub) {
+            ++in_index;
+        } else {
+            const Weight weight = out_entry.weight + in_entry.weight;
+            if (!best_weight || weight < *best_weight) {
+                best_weight = weight;
+                best_hub = out_entry.hub;
+            }
+            ++out_index;
+            ++in_index;
+        }
+    }
+    if (!best_weight) {
+        return std::nullopt;
+    }
+
+    // Путь from -> hub идет по первым ребрам исходящих меток, hub -> to - по последним ребрам входящих
+    const VertexId hub = hubs_[best_hub];
+    std::vector<EdgeId> edges;
+    for (VertexId vertex = from; vertex != hub;) {
+        const EdgeId edge_id = FindEntry(out_offsets_, out_entries_, vertex, best_hub).parent_edge;
+        edges.push_back(edge_id);
+        vertex = graph_.GetEdge(edge_id).to;
+    }
+    const size_t hub_position = edges.size();
+    for (VertexId vertex = to; vertex != hub;) {
+        const EdgeId edge_id = FindEntry(in_offsets_, in_entries_, vertex, best_hub).parent_edge;
+        edges.push_back(edge_id);
+        vertex = graph_.GetEdge(edge_id).from;
+    }
+    std::reverse(edges.begin() + hub_position, edges.end());
+
+    Weight weight = ZERO_WEIGHT;
+    std::vector<Weight> arrival_weights;
+    arrival_weights.reserve(edges.size());
+    for (const EdgeId edge_id : edges) {
+        weight += graph_.GetEdge(edge_id).weight;
+        arrival_weights.push_back(weight);
+    }
+    if (has_zero_weight_) {
+        return RouteInfo{weight, std::move(edges)};
+    }
+
+    // Путь собирается заново от to: последним берется наименьшее ребро (u, v), для которого
+    // d(from, u) + вес ребра = d(from, v). d(from, u) - слияние исходящей метки from, разложенной
+    // по рангам хабов, с входящей меткой u. Ребро найденного пути годится всегда, поэтому для вершин
+    // этого пути проверяются только ребра меньше него
+    SearchScratch& scratch = GetScratch();
+    scratch.Prepare(vertex_count);
+    for (size_t i = out_offsets_[from]; i < out_offsets_[from + 1]; ++i) {
+        scratch.root_marks[out_entries_[i].hub] = scratch.search_mark;
+        scratch.root_weights[out_entries_[i].hub] = out_entries_[i].weight;
+    }
+    const auto is_within = [&](VertexId vertex, Weight max_weight) {
+        for (size_t i = in_offsets_[vertex]; i < in_offsets_[vertex + 1]; ++i) {
+            const LabelEntry& entry = in_entries_[i];
+            if (scratch.root_marks[entry.hub] == scratch.search_mark && scratch.root_weights[entry.hub] + entry.weight <= max_weight) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    std::vector<EdgeId> canonical_edges;
+    VertexId vertex = to;
+    Weight vertex_weight = weight;
+    size_t position = edges.size();
+    while (vertex != from) {
+        while (position > 0 && arrival_weights[position - 1] > vertex_weight) {
+            --position;
+        }
+        EdgeId edge_id = NO_PARENT_EDGE;
+        if (position > 0 && arrival_weights[position - 1] == vertex_weight && graph_.GetEdge(edges[position - 1]).to == vertex) {
+            edge_id = edges[position - 1];
+        }
+        // Ребра идут по возрастанию, поэтому первое подходящее - наименьшее
+        for (size_t i = in_edge_offsets_[vertex]; i < in_edge_offsets_[vertex + 1] && in_edges_[i] < edge_id; ++i) {
+            const auto& edge = graph_.GetEdge(in_edges_[i]);
+            if (edge.from != vertex && edge.weight <= vertex_weight && is_within(edge.from, vertex_weight - edge.weight)) {
+                edge_id = in_edges_[i];
+                break;
+            }
+        }
+        if (edge_id == NO_PARENT_EDGE) {
+            // Недостижимо при положительных весах: до вершины на кратчайшем пути всегда ведет ребро
+            return RouteInfo{weight, std::move(edges)};
+        }
+        canonical_edges.push_back(edge_id);
+        vertex_weight -= graph_.GetEdge(edge_id).weight;
+        vertex = graph_.GetEdge(edge_id).from;
+    }
+    std::reverse(canonical_edges.begin(), canonical_edges.end());
+    return RouteInfo{weight, std::move(canonical_edges)};
+}
+
+}  // namespace graph
@@ -3,8 +3,13 @@
 #include "domain.h"
 #include "geo.h"
 #include "json_builder.h"
+#include "parallel.h"
 
 #include <algorithm>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <set>
 #include <string_view>
 #include <sstream>
 
@@ -73,8 +78,8 @@ namespace json_reader{
             out.emplace_back(Builder{}.StartDict().Key("request_id").Value(request_id).Key("map").Value(result.str()).EndDict().Build());
         }
 
-        void GetRoute(Array& out, const Dict& request_info, const RequestHandler& requestHandler){
-            auto [total_time, items] = requestHandler.GetRoute(request_info.at("from").AsString(), request_info.at("to").AsString());
+        void GetRoute(Array& out, const Dict& request_info, const transport_router::RouteInfo& route){
+            const auto& [total_time, items] = route;
             if(!total_time.has_value() && items.empty()){
                 out.emplace_back(Builder{}.StartDict()
                                                     .Key("error_message").Value("not found")
@@ -106,6 +111,63 @@ namespace json_reader{
             }
         }
 
+        //Профиль маршрутизации запроса, без ключа profile - основной
+        std::string_view GetRoutingProfile(const Dict& request_info){
+            const auto it = request_info.find("profile");
+            return it == request_info.end() ? std::string_view{} : std::string_view{it->second.AsString()};
+        }
+
+        //Матрица времен в пути без разбивки на участки; недостижимые пары - null
+        void GetMatrix(Array& out, const Dict& request_info, const RequestHandler& requestHandler){
+            std::vector<std::string_view> from_stops;
+            std::vector<std::string_view> to_stops;
+            for(const Node& stop : request_info.at("from").AsArray()){
+                from_stops.push_back(stop.AsString());
+            }
+            for(const Node& stop : request_info.at("to").AsArray()){
+                to_stops.push_back(stop.AsString());
+            }
+            const auto is_unknown = [&requestHandler](std::string_view name){
+                return requestHandler.FindStop(name) == nullptr;
+            };
+            const std::string_view profile = GetRoutingProfile(request_info);
+            if(std::any_of(from_stops.begin(), from_stops.end(), is_unknown) || std::any_of(to_stops.begin(), to_stops.end(), is_unknown)
+               || !requestHandler.HasRoutingProfile(profile)){
+                out.emplace_back(Builder{}.StartDict().Key("request_id").Value(request_info.at("id")).Key("error_message").Value("not found").EndDict().Build());
+                return;
+            }
+
+            Array total_times;
+            total_times.reserve(from_stops.size());
+            for(const auto& row : requestHandler.GetMatrix(from_stops, to_stops, profile)){
+                Array times;
+                times.reserve(row.size());
+                for(const std::optional<double>& time : row){
+                    times.push_back(time ? Node{*time} : Node{nullptr});
+                }
+                total_times.push_back(Node{std::move(times)});
+            }
+            out.emplace_back(Builder{}.StartDict().Key("request_id").Value(request_info.at("id")).Key("total_times").Value(std::move(total_times)).EndDict().Build());
+        }
+
+        //Остановки, достижимые за max_time минут, с временами прибытия
+        void GetReachable(Array& out, const Dict& request_info, const RequestHandler& requestHandler){
+            const std::string& name = request_info.at("from").AsString();
+            const std::string_view profile = GetRoutingProfile(request_info);
+            if(requestHandler.FindStop(name) == nullptr || !requestHandler.HasRoutingProfile(profile)){
+                out.emplace_back(Builder{}.StartDict().Key("request_id").Value(request_info.at("id")).Key("error_message").Value("not found").EndDict().Build());
+                return;
+            }
+
+            Array stops;
+            for(const transport_router::ReachableStop& stop : requestHandler.GetReachable(name, request_info.at("max_time").AsDouble(), profile)){
+                stops.emplace_back(Builder{}.StartDict()
+                                                .Key("stop_name").Value(std::string(stop.stop_name_))
+                                                .Key("time").Value(stop.time_).EndDict().Build());
+            }
+            out.emplace_back(Builder{}.StartDict().Key("request_id").Value(request_info.at("id")).Key("stops").Value(std::move(stops)).EndDict().Build());
+        }
+
         //Обрабатывает запросы к базе данных
         void DataRequestHandle(const Array& data_requests, RequestHandler& requestHandler){
             for(size_t i = 0; i < data_requests.size(); i++){
@@ -118,23 +180,92 @@ namespace json_reader{
             }
         }
 
-        //Обрабатывает запросы на получение статистики
-        void StatRequestHandle(Array& out, const Array& stat_requests, const RequestHandler& requestHandler){
+        //Запросы, которым нужен роутер
+        bool IsRoutingRequest(const Dict& request){
+            const std::string& type = request.at("type").AsString();
+            return type == "Route" || type == "Matrix" || type == "Reachable";
+        }
+
+        //Запросы, на которые дается ответ; остальные пропускаются
+        bool IsAnsweredRequest(const Dict& request){
+            const std::string& type = request.at("type").AsString();
+            return type == "Stop" || type == "Bus" || type == "Map" || IsRoutingRequest(request);
+        }
+
+        //Обрабатывает запросы на получение статистики. Ответы записываются на места запросов: сначала
+        //отвечаются запросы к справочнику и карте, затем, после ожидания построения роутера, маршрутные
+        void StatRequestHandle(Array& out, const Array& stat_requests, const RequestHandler& requestHandler, const std::function<void()>& wait_router){
+            //Место ответа на каждый запрос; запросы неизвестного типа места не получают
+            std::vector<size_t> positions(stat_requests.size());
+            size_t answer_count = 0;
+            for(size_t i = 0; i < stat_requests.size(); i++){
+                positions[i] = answer_count;
+                answer_count += IsAnsweredRequest(stat_requests.at(i).AsDict()) ? 1 : 0;
+            }
+            out.assign(answer_count, Node{});
+            Array answer;
+            const auto put_answer = [&out, &answer, &positions](size_t i){
+                out[positions[i]] = std::move(answer.back());
+                answer.clear();
+            };
             for(size_t i = 0; i < stat_requests.size(); i++){
                 if(stat_requests.at(i).AsDict().at("type") == "Stop"){
-                    GetStopInfo(out, stat_requests.at(i).AsDict(), requestHandler);
+                    GetStopInfo(answer, stat_requests.at(i).AsDict(), requestHandler);
                 }
                 else if(stat_requests.at(i).AsDict().at("type") == "Bus"){
-                    GetBusInfo(out, stat_requests.at(i).AsDict(), requestHandler);
+                    GetBusInfo(answer, stat_requests.at(i).AsDict(), requestHandler);
                 }
                 else if(stat_requests.at(i).AsDict().at("type") == "Map"){
-                    GetMap(out, requestHandler, stat_requests.at(i).AsDict().at("id").AsInt());
+                    GetMap(answer, requestHandler, stat_requests.at(i).AsDict().at("id").AsInt());
                 }
-                else if(stat_requests.at(i).AsDict().at("type") == "Route"){
-                    GetRoute(out, stat_requests.at(i).AsDict(), requestHandler);
+                else{
+                    continue;
                 }
+                put_answer(i);
+            }
+            wait_router();
+
+            //Запросы Route отвечаются одним пакетом на профиль.
+            //Маршрут с неизвестным профилем остается пустым и выводится как "not found"
+            std::map<std::string_view, std::vector<size_t>> profile_routes;
+            std::vector<std::pair<std::string_view, std::string_view>> route_pairs;
+            for(const Node& request : stat_requests){
+                if(request.AsDict().at("type") == "Route"){
+                    profile_routes[GetRoutingProfile(request.AsDict())].push_back(route_pairs.size());
+                    route_pairs.emplace_back(request.AsDict().at("from").AsString(), request.AsDict().at("to").AsString());
+                }
+            }
+            std::vector<transport_router::RouteInfo> routes(route_pairs.size(), transport_router::RouteInfo{std::nullopt, {}});
+            for(const auto& [profile, indices] : profile_routes){
+                if(!requestHandler.HasRoutingProfile(profile)){
+                    continue;
+                }
+                std::vector<std::pair<std::string_view, std::string_view>> pairs;
+                pairs.reserve(indices.size());
+                for(const size_t index : indices){
+                    pairs.push_back(route_pairs[index]);
+                }
+                std::vector<transport_router::RouteInfo> found = requestHandler.GetRoutes(pairs, profile);
+                for(size_t i = 0; i < indices.size(); i++){
+                    routes[indices[i]] = std::move(found[i]);
+                }
+            }
+            size_t route_index = 0;
+            for(size_t i = 0; i < stat_requests.size(); i++){
+                if(stat_requests.at(i).AsDict().at("type") == "Route"){
+                    GetRoute(answer, stat_requests.at(i).AsDict(), routes[route_index++]);
+                }
+                else if(stat_requests.at(i).AsDict().at("type") == "Matrix"){
+                    GetMatrix(answer, stat_requests.at(i).AsDict(), requestHandler);
+                }
+                else if(stat_requests.at(i).AsDict().at("type") == "Reachable"){
+                    GetReachable(answer, stat_requests.at(i).AsDict(), requestHandler);
+                }
+                else{
+                    continue;
+                }
+                put_answer(i);
             }
-
         }
 
         void SortRequest(Array& requests){
@@ -148,6 +279,54 @@ namespace json_reader{
             }
         }
 
+        const std::vector<std::pair<std::string, transport_router::RouterEngine>> RouterEngineNames = {
+            {"auto", transport_router::RouterEngine::AUTO},
+            {"all_pairs", transport_router::RouterEngine::ALL_PAIRS},
+            {"dijkstra", transport_router::RouterEngine::DIJKSTRA},
+            {"source_cached", transport_router::RouterEngine::SOURCE_CACHED},
+            {"contraction_hierarchy", transport_router::RouterEngine::CONTRACTION_HIERARCHY},
+            {"hub_labels", transport_router::RouterEngine::HUB_LABELS},
+            {"raptor", transport_router::RouterEngine::RAPTOR}
+        };
+
+        transport_router::RouterEngine NodeToRouterEngine(const Node& node){
+            const std::string& engine = node.AsString();
+            for(const auto& [name, value] : RouterEngineNames){
+                if(name == engine){
+                    return value;
+                }
+            }
+            throw std::invalid_argument("unknown router engine: " + engine);
+        }
+
+        std::string RouterEngineToString(transport_router::RouterEngine engine){
+            for(const auto& [name, value] : RouterEngineNames){
+                if(value == engine){
+                    return name;
+                }
+            }
+            return {};
+        }
+
+        //Считает запросы Route и различные остановки отправления в них; ячейка Matrix считается как Route
+        void CountRouteRequests(const Array& stat_requests, transport_router::RoutingSettings& settings){
+            std::set<std::string> sources;
+            for(const Node& request : stat_requests){
+                if(request.AsDict().at("type") == "Route"){
+                    settings.expected_queries++;
+                    sources.insert(request.AsDict().at("from").AsString());
+                }
+                else if(request.AsDict().at("type") == "Matrix"){
+                    const Array& from_stops = request.AsDict().at("from").AsArray();
+                    settings.expected_queries += from_stops.size() * request.AsDict().at("to").AsArray().size();
+                    for(const Node& stop : from_stops){
+                        sources.insert(stop.AsString());
+                    }
+                }
+            }
+            settings.expected_sources = sources.size();
+        }
+
         svg::Color NodeToColor(const Node& node){
             svg::Color color;
             if(node.IsArray()){
@@ -177,20 +356,95 @@ namespace json_reader{
         stat_requests = requests.at("stat_requests").AsArray();
         routing_settings = requests.at("routing_settings").AsDict();
         render_settings = requests.at("render_settings").AsDict();
+        if(requests.count("update_requests")){
+            update_requests = requests.at("update_requests").AsArray();
+        }
+        if(requests.count("diagnostics")){
+            diagnostics = requests.at("diagnostics").AsBool();
+        }
     }
 
     void JsonReader::HandleBaseRequests(){
         Array& value_as_array = const_cast<Array&>(base_requests);
         details::SortRequest(value_as_array);
         details::DataRequestHandle(value_as_array, requestHandler_);
+        requestHandler_.Finalize();
         base_requests.clear();
     }
 
     void JsonReader::HandleRoutingSettings(){
         if(!routing_settings.empty()){
-            int bus_wait_time = routing_settings["bus_wait_time"].AsInt();
-            double bus_velocity = routing_settings["bus_velocity"].AsDouble();
-            requestHandler_.CreateRoute(bus_wait_time, bus_velocity);
+            transport_router::RoutingSettings settings;
+            settings.bus_wait_time = routing_settings["bus_wait_time"].AsInt();
+            settings.bus_velocity = routing_settings["bus_velocity"].AsDouble();
+            if(routing_settings.count("router_engine")){
+                settings.engine = details::NodeToRouterEngine(routing_settings.at("router_engine"));
+            }
+            if(routing_settings.count("router_memory_limit_mb")){
+                settings.memory_limit_bytes = static_cast<size_t>(routing_settings.at("router_memory_limit_mb").AsInt()) << 20;
+            }
+            if(routing_settings.count("source_cache_mb")){
+                settings.source_cache_bytes = static_cast<size_t>(routing_settings.at("source_cache_mb").AsInt()) << 20;
+            }
+            if(routing_settings.count("profiles")){
+                //Незаданные ожидание и скорость профиля берутся из основного
+                for(const Node& profile_node : routing_settings.at("profiles").AsArray()){
+                    const Dict& profile = profile_node.AsDict();
+                    settings.profiles.push_back({profile.at("name").AsString(),
+                                                 profile.count("bus_wait_time") ? profile.at("bus_wait_time").AsInt() : settings.bus_wait_time,
+                                                 profile.count("bus_velocity") ? profile.at("bus_velocity").AsDouble() : settings.bus_velocity});
+                }
+            }
+            settings.thread_count = routing_settings.count("router_threads") ? static_cast<size_t>(routing_settings.at("router_threads").AsInt())
+                                                                             : parallel::DefaultThreadCount();
+            details::CountRouteRequests(stat_requests, settings);
+            requestHandler_.CreateRoute(settings);
+        }
+    }
+
+    void JsonReader::HandleUpdateRequests(){
+        for(const Node& request : update_requests){
+            const Dict& parameters = request.AsDict();
+            //Остановка в формате base_requests: новая добавляется, у существующей меняются только расстояния
+            if(parameters.at("type") == "Stop"){
+                const std::string& name = parameters.at("name").AsString();
+                geo::Coordinates coord{};
+                if(requestHandler_.FindStop(name) == nullptr){
+                    coord = {parameters.at("latitude").AsDouble(), parameters.at("longitude").AsDouble()};
+                }
+                std::vector<transport_catalogue::DistanceToStop> distances;
+                if(parameters.count("road_distances")){
+                    for(const auto& [stop, distance] : parameters.at("road_distances").AsDict()){
+                        distances.push_back({stop, distance.AsInt()});
+                    }
+                }
+                requestHandler_.HotUpdateStop(name, coord, distances);
+            }
+            else if(parameters.at("type") == "Bus"){
+                std::vector<std::string> stops;
+                for(const Node& stop_name : parameters.at("stops").AsArray()){
+                    stops.push_back(stop_name.AsString());
+                }
+                requestHandler_.HotAddBus(parameters.at("name").AsString(), std::vector<std::string_view>(stops.begin(), stops.end()),
+                                          parameters.at("is_roundtrip").AsBool());
+            }
+        }
+        update_requests.clear();
+    }
+
+    void JsonReader::StartRouterBuild(){
+        //На одном ядре фоновый поток только отнимает время у ответов: роутер построится при первом запросе
+        StartRouterBuild(parallel::DefaultThreadCount() > 1);
+    }
+
+    void JsonReader::StartRouterBuild(bool background){
+        const bool has_routing = std::any_of(stat_requests.begin(), stat_requests.end(), [](const Node& request){
+            return details::IsRoutingRequest(request.AsDict());
+        });
+        if(background && !routing_settings.empty() && has_routing){
+            router_build = std::async(std::launch::async, [this]{
+                requestHandler_.BuildRoute();
+            });
         }
     }
 
@@ -230,10 +484,88 @@ namespace json_reader{
     void JsonReader::HandleStatRequest(std::ostream& out){
         Array answer;
         if(!stat_requests.empty()){
-            details::StatRequestHandle(answer, stat_requests, requestHandler_);
+            details::StatRequestHandle(answer, stat_requests, requestHandler_, [this]{
+                //Исключение построения роутера пробрасывается здесь, как при построении в основном потоке
+                if(router_build.valid()){
+                    const auto start = std::chrono::steady_clock::now();
+                    router_build.get();
+                    router_wait_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                }
+            });
         }
 
         Print(Document{answer}, out);
         stat_requests.clear();
     }
+
+    void JsonReader::HandleDiagnostics(std::ostream& out) const{
+        if(!diagnostics){
+            return;
+        }
+        const transport_catalogue::FinalizeStats& finalize_stats = requestHandler_.GetFinalizeStats();
+        Node finalize = Builder{}.StartDict()
+                                    .Key("buses").Value(static_cast<int>(finalize_stats.buses_count))
+                                    .Key("threads").Value(static_cast<int>(finalize_stats.thread_count))
+                                    .Key("duration_ms").Value(finalize_stats.duration_ms).EndDict().Build();
+
+        const transport_router::RouterStats router_stats = requestHandler_.GetRouterStats();
+        Dict estimates;
+        for(const auto& [engine, estimate] : router_stats.estimates){
+            estimates[details::RouterEngineToString(engine)] = Builder{}.StartDict()
+                                                                            .Key("memory_mb").Value(static_cast<double>(estimate.memory_bytes) / (1 << 20))
+                                                                            .Key("operations").Value(estimate.operations).EndDict().Build();
+        }
+        Node source_cache = Builder{}.StartDict()
+                                    .Key("hits").Value(static_cast<int>(router_stats.source_cache.hits))
+                                    .Key("misses").Value(static_cast<int>(router_stats.source_cache.misses))
+                                    .Key("evictions").Value(static_cast<int>(router_stats.source_cache.evictions))
+                                    .Key("trees").Value(static_cast<int>(router_stats.source_cache.tree_count))
+                                    .Key("mb").Value(static_cast<double>(router_stats.source_cache.bytes) / (1 << 20)).EndDict().Build();
+        Array profiles;
+        for(const transport_router::ProfileStats& profile : router_stats.profiles){
+            profiles.emplace_back(Builder{}.StartDict()
+                                            .Key("name").Value(profile.name)
+                                            .Key("built").Value(profile.built)
+                                            .Key("build_ms").Value(profile.build_duration_ms).EndDict().Build());
+        }
+        Array bus_updates;
+        for(const transport_router::BusUpdateStats& update : router_stats.bus_updates){
+            bus_updates.emplace_back(Builder{}.StartDict()
+                                                .Key("bus").Value(update.bus_name)
+                                                .Key("added_edges").Value(static_cast<int>(update.added_edge_count))
+                                                .Key("dominated_edges").Value(static_cast<int>(update.dominated_edge_count))
+                                                .Key("incremental").Value(update.incremental)
+                                                .Key("relaxed_rows").Value(static_cast<int>(update.relaxed_row_count))
+                                                .Key("duration_ms").Value(update.duration_ms).EndDict().Build());
+        }
+        Node router = Builder{}.StartDict()
+                                .Key("engine").Value(details::RouterEngineToString(router_stats.engine))
+                                .Key("engine_forced").Value(router_stats.engine_forced)
+                                .Key("vertices").Value(static_cast<int>(router_stats.vertex_count))
+                                .Key("edges").Value(static_cast<int>(router_stats.edge_count))
+                                .Key("dominated_edges").Value(static_cast<int>(router_stats.dominated_edge_count))
+                                .Key("estimates").Value(estimates)
+                                .Key("relax_kernel").Value(router_stats.relax_kernel)
+                                .Key("shortcuts").Value(static_cast<int>(router_stats.shortcut_count))
+                                .Key("labels").Value(static_cast<int>(router_stats.label_count))
+                                .Key("index_mb").Value(static_cast<double>(router_stats.index_bytes) / (1 << 20))
+                                .Key("source_cache").Value(source_cache)
+                                .Key("routes").Value(static_cast<int>(router_stats.route_count))
+                                .Key("average_route_us").Value(router_stats.average_route_us)
+                                .Key("matrix_cells").Value(static_cast<int>(router_stats.matrix_cell_count))
+                                .Key("matrix_ms").Value(router_stats.matrix_duration_ms)
+                                .Key("reachable").Value(static_cast<int>(router_stats.reachable_count))
+                                .Key("reachable_ms").Value(router_stats.reachable_duration_ms)
+                                .Key("profiles").Value(profiles)
+                                .Key("bus_updates").Value(bus_updates)
+                                .Key("built").Value(router_stats.built)
+                                .Key("builds").Value(static_cast<int>(router_stats.build_count))
+                                .Key("skipped_builds").Value(static_cast<int>(router_stats.skipped_build_count))
+                                .Key("distance_rebuilds").Value(static_cast<int>(router_stats.distance_rebuild_count))
+                                .Key("wait_ms").Value(router_wait_ms)
+                                .Key("build_ms").Value(router_stats.build_duration_ms).EndDict().Build();
+
+        Print(Document{Builder{}.StartDict().Key("finalize").Value(finalize).Key("router").Value(router).EndDict().Build()}, out);
+        out << std::endl;
+    }
 }
\ No newline at end of file
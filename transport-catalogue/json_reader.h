@@ -5,6 +5,7 @@
 #include "json.h"
 #include "map_renderer.h"
 
+#include <future>
 #include <iostream>
 
 namespace json_reader{
@@ -15,14 +16,31 @@ namespace json_reader{
         void ReadRequests(std::istream& in);
         void HandleBaseRequests();
         void HandleRoutingSettings();
+        // Автобусы и остановки с расстояниями из "update_requests", добавляемые после загрузки базы
+        void HandleUpdateRequests();
+        // Запускает построение роутера в фоновом потоке, если в stat_requests есть маршрутные запросы
+        // и процессор многоядерный.
+        // Вызывается после HandleRoutingSettings и HandleUpdateRequests
+        void StartRouterBuild();
+        // То же с явным выбором: при background == false роутер построится при первом маршрутном запросе.
+        // Ответы от выбора не зависят
+        void StartRouterBuild(bool background);
         void HandleRenderSettings();
+        // Сначала отвечает на запросы, не зависящие от роутера, затем ждет его построения
         void HandleStatRequest(std::ostream& out);
+        // Печатает статистику обработки, если во входных данных задано "diagnostics": true
+        void HandleDiagnostics(std::ostream& out) const;
 
     private:
         RequestHandler& requestHandler_;
         json::Array base_requests;
         json::Array stat_requests;
+        json::Array update_requests;
         json::Dict render_settings;
         json::Dict routing_settings;
+        bool diagnostics = false;
+        std::future<void> router_build;
+        // Сколько ответ на запросы простоял в ожидании фонового построения роутера
+        double router_wait_ms = 0;
     };
 }
\ No newline at end of file
@@ -16,6 +16,9 @@ int main() {
     json_reader_.ReadRequests(std::cin);
     json_reader_.HandleBaseRequests();
     json_reader_.HandleRoutingSettings();
+    json_reader_.HandleUpdateRequests();
+    json_reader_.StartRouterBuild();
     json_reader_.HandleRenderSettings();
     json_reader_.HandleStatRequest(std::cout);
+    json_reader_.HandleDiagnostics(std::cerr);
 }
\ No newline at end of file
@@ -0,0 +1,85 @@
+#include "parallel.h"
+
+namespace parallel {
+
+WorkerPool::WorkerPool(size_t thread_count)
+    : errors_(std::max<size_t>(1, thread_count)) {
+    for (size_t worker = 1; worker < thread_count; ++worker) {
+        threads_.emplace_back([this, worker] {
+            WorkerLoop(worker);
+        });
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    start_cv_.notify_all();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+}
+
+void WorkerPool::Run(const std::function<void(size_t)>& task) {
+    if (threads_.empty()) {
+        task(0);
+        return;
+    }
+    {
+        std::lock_guard lock(mutex_);
+        task_ = &task;
+        pending_ = threads_.size();
+        ++generation_;
+    }
+    start_cv_.notify_all();
+
+    try {
+        task(0);
+    } catch (...) {
+        errors_[0] = std::current_exception();
+    }
+
+    std::unique_lock lock(mutex_);
+    done_cv_.wait(lock, [this] {
+        return pending_ == 0;
+    });
+    task_ = nullptr;
+    for (auto& error : errors_) {
+        if (error) {
+            std::exception_ptr first_error = error;
+            std::fill(errors_.begin(), errors_.end(), nullptr);
+            std::rethrow_exception(first_error);
+        }
+    }
+}
+
+void WorkerPool::WorkerLoop(size_t worker) {
+    size_t seen_generation = 0;
+    while (true) {
+        std::unique_lock lock(mutex_);
+        start_cv_.wait(lock, [this, seen_generation] {
+            return stopping_ || generation_ != seen_generation;
+        });
+        if (stopping_) {
+            return;
+        }
+        seen_generation = generation_;
+        const std::function<void(size_t)>* task = task_;
+        lock.unlock();
+
+        try {
+            (*task)(worker);
+        } catch (...) {
+            errors_[worker] = std::current_exception();
+        }
+
+        lock.lock();
+        if (--pending_ == 0) {
+            done_cv_.notify_one();
+        }
+    }
+}
+
+}  // namespace parallel
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdlib>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace parallel {
+
+inline size_t DefaultThreadCount() {
+    return std::max<size_t>(1, std::thread::hardware_concurrency());
+}
+
+// Делит [0, count) на непрерывные куски и вызывает func(begin, end) для каждого
+// из них в отдельном потоке. Первый кусок выполняется в вызывающем потоке,
+// исключение из любого куска пробрасывается после завершения всех потоков
+template <typename Func>
+void ForEachChunk(size_t count, size_t thread_count, Func func) {
+    thread_count = std::max<size_t>(1, std::min(thread_count, count));
+    if (thread_count <= 1) {
+        if (count > 0) {
+            func(size_t{0}, count);
+        }
+        return;
+    }
+
+    const size_t chunk_size = (count + thread_count - 1) / thread_count;
+    std::vector<std::exception_ptr> errors(thread_count);
+    std::vector<std::thread> threads;
+    threads.reserve(thread_count - 1);
+
+    auto run_chunk = [&](size_t chunk) {
+        const size_t begin = chunk * chunk_size;
+        const size_t end = std::min(count, begin + chunk_size);
+        try {
+            if (begin < end) {
+                func(begin, end);
+            }
+        } catch (...) {
+            errors[chunk] = std::current_exception();
+        }
+    };
+
+    for (size_t chunk = 1; chunk < thread_count; ++chunk) {
+        threads.emplace_back(run_chunk, chunk);
+    }
+    run_chunk(0);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (const auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+// Постоянные потоки для многократных параллельных фаз, чтобы не создавать потоки на каждую.
+// Вызывающий поток участвует в работе как исполнитель с номером 0
+class WorkerPool {
+public:
+    explicit WorkerPool(size_t thread_count);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    size_t GetThreadCount() const {
+        return threads_.size() + 1;
+    }
+
+    // То же, что parallel::ForEachChunk, но на потоках пула
+    template <typename Func>
+    void ForEachChunk(size_t count, Func func) {
+        const size_t chunk_count = GetThreadCount();
+        const size_t chunk_size = (count + chunk_count - 1) / chunk_count;
+        Run([&](size_t chunk) {
+            const size_t begin = chunk * chunk_size;
+            const size_t end = std::min(count, begin + chunk_size);
+            if (begin < end) {
+                func(begin, end);
+            }
+        });
+    }
+
+private:
+    // Выполняет task(номер исполнителя) на каждом исполнителе и ждет завершения всех
+    void Run(const std::function<void(size_t)>& task);
+    void WorkerLoop(size_t worker);
+
+    std::vector<std::thread> threads_;
+    std::mutex mutex_;
+    std::condition_variable start_cv_;
+    std::condition_variable done_cv_;
+    const std::function<void(size_t)>* task_ = nullptr;
+    std::vector<std::exception_ptr> errors_;
+    size_t generation_ = 0;
+    size_t pending_ = 0;
+    bool stopping_ = false;
+};
+
+}  // namespace parallel
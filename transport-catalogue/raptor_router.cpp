@@ -0,0 +1,262 @@
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <tuple>
+
+#include "raptor_router.h"
+
+namespace transport_router{
+
+namespace details{
+    const int64_t UnreachedWeight = std::numeric_limits<int64_t>::max();
+
+    // Рабочие массивы одного потока. arrivals[k] - лучшие прибытия не более чем с k поездками;
+    // метки позволяют не очищать массивы линий и остановок между раундами
+    struct RaptorScratch{
+        std::vector<std::vector<int64_t>> arrivals;
+        std::vector<int64_t> best;
+        std::vector<uint32_t> line_marks;
+        std::vector<uint32_t> first_positions;
+        std::vector<uint32_t> stop_marks;
+        uint32_t mark = 0;
+        std::vector<uint32_t> queued_lines;
+        std::vector<StopId> marked_stops;
+        std::vector<StopId> next_marked_stops;
+
+        void Prepare(size_t stop_count, size_t line_count){
+            if(line_marks.size() < line_count){
+                line_marks.resize(line_count, 0);
+                first_positions.resize(line_count);
+            }
+            if(stop_marks.size() < stop_count){
+                stop_marks.resize(stop_count, 0);
+            }
+            best.assign(stop_count, UnreachedWeight);
+            marked_stops.clear();
+        }
+
+        uint32_t NextMark(){
+            if(++mark == 0){
+                std::fill(line_marks.begin(), line_marks.end(), 0);
+                std::fill(stop_marks.begin(), stop_marks.end(), 0);
+                mark = 1;
+            }
+            return mark;
+        }
+
+        // Раунд round начинается с копии прошлого: прибытие не ухудшается с ростом числа поездок
+        void StartRound(size_t round, size_t stop_count){
+            if(arrivals.size() <= round){
+                arrivals.resize(round + 1);
+            }
+            if(round == 0){
+                arrivals[0].assign(stop_count, UnreachedWeight);
+            }
+            else{
+                arrivals[round] = arrivals[round - 1];
+            }
+        }
+    };
+
+    RaptorScratch& GetRaptorScratch(){
+        static thread_local RaptorScratch scratch;
+        return scratch;
+    }
+}
+
+RaptorRouter::RaptorRouter(const transport_catalogue::TransportCatalogue& catalogue, double bus_wait_time, double speed,
+                           int64_t wait_weight, int64_t meter_weight)
+    : bus_wait_time_(bus_wait_time), speed_(speed), wait_weight_(wait_weight), meter_weight_(meter_weight), stop_lines_(catalogue.GetStopsCount()){
+    for(const Bus& bus : catalogue.GetBuses()){
+        const size_t stops_count = bus.stops.size();
+        for(const bool reverse : {false, true}){
+            if(reverse && bus.is_round){
+                continue;
+            }
+            // Накопленные расстояния обратной линии отсчитываются от последней остановки автобуса
+            Line line{bus.id, {}, {}};
+            line.stops.reserve(stops_count);
+            line.distances.reserve(stops_count);
+            for(size_t i = 0; i < stops_count; i++){
+                const size_t position = reverse ? stops_count - 1 - i : i;
+                line.stops.push_back(bus.stops[position]->id);
+                line.distances.push_back(bus.GetRoadDistance(reverse ? stops_count - 1 : 0, position));
+                stop_lines_[line.stops.back()].push_back({static_cast<uint32_t>(lines_.size()), static_cast<uint32_t>(i)});
+            }
+            lines_.push_back(std::move(line));
+        }
+    }
+}
+
+RaptorRouter RaptorRouter::WithProfile(double bus_wait_time, double speed, int64_t wait_weight) const{
+    RaptorRouter router = *this;
+    router.bus_wait_time_ = bus_wait_time;
+    router.speed_ = speed;
+    router.wait_weight_ = wait_weight;
+    return router;
+}
+
+size_t RaptorRouter::CountLinePositions(const transport_catalogue::TransportCatalogue& catalogue){
+    size_t positions = 0;
+    for(const Bus& bus : catalogue.GetBuses()){
+        positions += bus.stops.size() * (bus.is_round ? 1 : 2);
+    }
+    return positions;
+}
+
+size_t RaptorRouter::GetLineCount() const{
+    return lines_.size();
+}
+
+size_t RaptorRouter::GetMemoryBytes() const{
+    size_t bytes = lines_.size() * sizeof(Line) + stop_lines_.size() * sizeof(std::vector<LinePosition>);
+    for(const Line& line : lines_){
+        bytes += line.stops.size() * (sizeof(StopId) + sizeof(int));
+    }
+    for(const auto& positions : stop_lines_){
+        bytes += positions.size() * sizeof(LinePosition);
+    }
+    return bytes;
+}
+
+double RaptorRouter::GetRideTime(const Line& line, uint32_t board, uint32_t alight) const{
+    // Тот же расчет, что у времени ребра графа: целое расстояние, деленное на скорость
+    return (line.distances[alight] - line.distances[board]) / speed_;
+}
+
+int64_t RaptorRouter::GetRideWeight(const Line& line, uint32_t board, uint32_t alight) const{
+    return std::max<int64_t>(1, (line.distances[alight] - line.distances[board]) * meter_weight_);
+}
+
+void RaptorRouter::RunRounds(StopId from, std::optional<StopId> to, int64_t max_weight) const{
+    const size_t stop_count = stop_lines_.size();
+    details::RaptorScratch& scratch = details::GetRaptorScratch();
+    scratch.Prepare(stop_count, lines_.size());
+    scratch.StartRound(0, stop_count);
+    scratch.arrivals[0][from] = 0;
+    scratch.best[from] = 0;
+    scratch.marked_stops.push_back(from);
+
+    size_t round = 0;
+    while(!scratch.marked_stops.empty()){
+        ++round;
+        scratch.StartRound(round, stop_count);
+
+        // Каждая линия через улучшенные остановки просматривается один раз с самой ранней из них
+        const uint32_t line_mark = scratch.NextMark();
+        scratch.queued_lines.clear();
+        for(const StopId stop : scratch.marked_stops){
+            for(const LinePosition& line_position : stop_lines_[stop]){
+                if(scratch.line_marks[line_position.line] != line_mark){
+                    scratch.line_marks[line_position.line] = line_mark;
+                    scratch.first_positions[line_position.line] = line_position.position;
+                    scratch.queued_lines.push_back(line_position.line);
+                }
+                else{
+                    scratch.first_positions[line_position.line] = std::min(scratch.first_positions[line_position.line], line_position.position);
+                }
+            }
+        }
+
+        const uint32_t stop_mark = scratch.NextMark();
+        scratch.next_marked_stops.clear();
+        const std::vector<int64_t>& previous = scratch.arrivals[round - 1];
+        std::vector<int64_t>& current = scratch.arrivals[round];
+        for(const uint32_t line_index : scratch.queued_lines){
+            const Line& line = lines_[line_index];
+            // Лучшая посадка до текущей позиции: минимум прибытия минус накопленный вес линии. Из равных
+            // берется ранняя: поездке нулевой длины начисляется тик, а у ранней посадки она длиннее
+            std::optional<uint32_t> board;
+            int64_t board_key = 0;
+            for(uint32_t position = scratch.first_positions[line_index]; position < line.stops.size(); position++){
+                const StopId stop = line.stops[position];
+                if(board){
+                    const int64_t arrival = previous[line.stops[*board]] + wait_weight_ + GetRideWeight(line, *board, position);
+                    if(arrival < scratch.best[stop] && arrival <= max_weight && (!to || arrival < scratch.best[*to])){
+                        current[stop] = arrival;
+                        scratch.best[stop] = arrival;
+                        if(scratch.stop_marks[stop] != stop_mark){
+                            scratch.stop_marks[stop] = stop_mark;
+                            scratch.next_marked_stops.push_back(stop);
+                        }
+                    }
+                }
+                if(previous[stop] != details::UnreachedWeight){
+                    const int64_t key = previous[stop] - line.distances[position] * meter_weight_;
+                    if(!board || key < board_key){
+                        board = position;
+                        board_key = key;
+                    }
+                }
+            }
+        }
+        std::swap(scratch.marked_stops, scratch.next_marked_stops);
+    }
+}
+
+//Как у ребер графа: поездка в stop с остановки посадки u - ребро из u с номером тем меньше, чем меньше u,
+//а из параллельных поездок в графе остается самая короткая, при равенстве - первая по порядку линий
+//и позиций. Поэтому из поездок, на которых достигается лучшее прибытие, берется наименьшая по
+//(остановка посадки, линия, позиция посадки, позиция высадки)
+JourneyLeg RaptorRouter::FindLastLeg(StopId stop, const std::vector<int64_t>& best) const{
+    std::optional<std::tuple<StopId, uint32_t, uint32_t, uint32_t>> last_trip;
+    for(const LinePosition& alight : stop_lines_[stop]){
+        const Line& line = lines_[alight.line];
+        for(uint32_t board = 0; board < alight.position; board++){
+            const StopId board_stop = line.stops[board];
+            if(best[board_stop] == details::UnreachedWeight || best[board_stop] + wait_weight_ + GetRideWeight(line, board, alight.position) != best[stop]){
+                continue;
+            }
+            const auto trip = std::make_tuple(board_stop, alight.line, board, alight.position);
+            if(!last_trip || trip < *last_trip){
+                last_trip = trip;
+            }
+        }
+    }
+    const auto [board_stop, line_index, board, alight] = last_trip.value();
+    const Line& line = lines_[line_index];
+    return {line.bus, board_stop, static_cast<int>(alight - board), GetRideTime(line, board, alight)};
+}
+
+std::optional<std::vector<JourneyLeg>> RaptorRouter::BuildJourney(StopId from, StopId to) const{
+    const size_t stop_count = stop_lines_.size();
+    if(from >= stop_count || to >= stop_count){
+        throw std::out_of_range("stop is out of range");
+    }
+
+    RunRounds(from, to, details::UnreachedWeight);
+    const details::RaptorScratch& scratch = details::GetRaptorScratch();
+    if(scratch.best[to] == details::UnreachedWeight){
+        return std::nullopt;
+    }
+
+    //Остановки раньше to получили точные лучшие прибытия: отсечение по to их не задевает
+    std::vector<JourneyLeg> legs;
+    for(StopId stop = to; stop != from; stop = legs.back().from_stop){
+        legs.push_back(FindLastLeg(stop, scratch.best));
+    }
+    std::reverse(legs.begin(), legs.end());
+    return legs;
+}
+
+std::vector<std::pair<StopId, int64_t>> RaptorRouter::FindReachable(StopId from, int64_t max_weight) const{
+    const size_t stop_count = stop_lines_.size();
+    if(from >= stop_count){
+        throw std::out_of_range("stop is out of range");
+    }
+    if(max_weight < 0){
+        return {};
+    }
+
+    RunRounds(from, std::nullopt, max_weight);
+    const details::RaptorScratch& scratch = details::GetRaptorScratch();
+    std::vector<std::pair<StopId, int64_t>> reachable;
+    for(StopId stop = 0; stop < stop_count; stop++){
+        if(scratch.best[stop] != details::UnreachedWeight){
+            reachable.emplace_back(stop, scratch.best[stop]);
+        }
+    }
+    return reachable;
+}
+
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "transport_catalogue.h"
+#include "domain.h"
+
+namespace transport_router{
+
+// Поездка маршрута: посадка на bus на остановке from_stop после ожидания и span_count пролетов
+struct JourneyLeg{
+    BusId bus;
+    StopId from_stop;
+    int span_count;
+    double time;
+};
+
+// Маршрутизатор в стиле RAPTOR: работает прямо по последовательностям остановок автобусов,
+// не строя ребер между всеми парами остановок. Раунд k находит лучшие прибытия с k поездками:
+// просматриваются линии через остановки, улучшенные в прошлом раунде. Прибытия считаются в целых
+// тиках, как веса ребер графа роутера, поэтому равные по времени маршруты сравниваются точно.
+// Кольцевой автобус - одна линия, некольцевой - две
+class RaptorRouter{
+public:
+    // speed - скорость в метрах в минуту, как у весов ребер графа. wait_weight и meter_weight - ожидание
+    // и метр поездки в тиках, те же, что у ребер графа профиля
+    RaptorRouter(const transport_catalogue::TransportCatalogue& catalogue, double bus_wait_time, double speed,
+                 int64_t wait_weight, int64_t meter_weight);
+    // Копия линий с другими ожиданием и скоростью, без обхода справочника
+    RaptorRouter WithProfile(double bus_wait_time, double speed, int64_t wait_weight) const;
+
+    // Из маршрутов с наименьшим временем выбирается тот же, что у движков графа: последняя поездка -
+    // с остановки посадки с меньшим номером, при равенстве - первая по порядку линий и позиций в них,
+    // так же выбирается маршрут до остановки посадки
+    std::optional<std::vector<JourneyLeg>> BuildJourney(StopId from, StopId to) const;
+    // Остановки, на которые из from можно прибыть не позже max_weight тиков, с весами прибытия,
+    // по возрастанию номера. Прибытия позже max_weight не улучшают метки и не порождают раундов
+    std::vector<std::pair<StopId, int64_t>> FindReachable(StopId from, int64_t max_weight) const;
+
+    size_t GetLineCount() const;
+    size_t GetMemoryBytes() const;
+
+    // Число позиций остановок во всех линиях - объем просмотра одного раунда
+    static size_t CountLinePositions(const transport_catalogue::TransportCatalogue& catalogue);
+
+private:
+    // Линия - автобус в одном направлении. distances[i] - накопленное расстояние до позиции i
+    struct Line{
+        BusId bus;
+        std::vector<StopId> stops;
+        std::vector<int> distances;
+    };
+
+    // Позиция остановки в линии
+    struct LinePosition{
+        uint32_t line;
+        uint32_t position;
+    };
+
+    double GetRideTime(const Line& line, uint32_t board, uint32_t alight) const;
+    // Вес поездки как у ребра графа: расстояние в тиках, не меньше тика
+    int64_t GetRideWeight(const Line& line, uint32_t board, uint32_t alight) const;
+    // Раунды из from, пока есть улучшенные остановки. Прибытие принимается, только если оно не позже
+    // max_weight и, при заданной to, раньше лучшего прибытия в to
+    void RunRounds(StopId from, std::optional<StopId> to, int64_t max_weight) const;
+    // Последняя поездка выбранного маршрута в stop по лучшим прибытиям best
+    JourneyLeg FindLastLeg(StopId stop, const std::vector<int64_t>& best) const;
+
+    double bus_wait_time_ = 0;
+    double speed_ = 0;
+    int64_t wait_weight_ = 0;
+    int64_t meter_weight_ = 0;
+    std::vector<Line> lines_;
+    // Линии через каждую остановку, по одной записи на каждое ее появление в линии
+    std::vector<std::vector<LinePosition>> stop_lines_;
+};
+
+}
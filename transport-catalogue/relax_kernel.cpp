@@ -0,0 +1,147 @@
+#include "relax_kernel.h"
+
+#include <limits>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define RELAX_KERNEL_X86 1
+#endif
+#endif
+
+namespace graph {
+
+namespace details {
+
+namespace {
+
+constexpr int64_t INFINITE_WEIGHT = std::numeric_limits<int64_t>::max();
+
+void RelaxRowScalar(int64_t from_weight, const int64_t* through_weights, const uint32_t* through_prev_edges,
+                    int64_t* weights, uint32_t* prev_edges, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        if (through_weights[i] == INFINITE_WEIGHT) {
+            continue;
+        }
+        const int64_t candidate_weight = from_weight + through_weights[i];
+        if (candidate_weight < weights[i] || (candidate_weight == weights[i] && through_prev_edges[i] < prev_edges[i])) {
+            weights[i] = candidate_weight;
+            prev_edges[i] = through_prev_edges[i];
+        }
+    }
+}
+
+#ifdef RELAX_KERNEL_X86
+
+// Беззнаковое сравнение 32-битных дорожек через знаковое со сдвигом на 2^31: маска lhs < rhs
+__attribute__((target("sse4.2")))
+__m128i LessUnsigned(__m128i lhs, __m128i rhs) {
+    const __m128i sign = _mm_set1_epi32(static_cast<int>(0x80000000u));
+    return _mm_cmpgt_epi32(_mm_xor_si128(rhs, sign), _mm_xor_si128(lhs, sign));
+}
+
+// Релаксирует две ячейки и возвращает маску улучшенных. prev_less - маска ячеек, у которых ребро
+// строки through меньше текущего, в 64-битных дорожках. Сравнение 64-битных целых появилось в SSE4.2
+__attribute__((target("sse4.2")))
+__m128 RelaxPairSse42(__m128i from, __m128i infinity, __m128i prev_less, const int64_t* through_weights, int64_t* weights) {
+    const __m128i through = _mm_loadu_si128(reinterpret_cast<const __m128i*>(through_weights));
+    const __m128i current = _mm_loadu_si128(reinterpret_cast<const __m128i*>(weights));
+    const __m128i candidate = _mm_add_epi64(from, through);
+    const __m128i better = _mm_or_si128(_mm_cmpgt_epi64(current, candidate), _mm_and_si128(_mm_cmpeq_epi64(current, candidate), prev_less));
+    const __m128i mask = _mm_andnot_si128(_mm_cmpeq_epi64(through, infinity), better);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(weights), _mm_blendv_epi8(current, candidate, mask));
+    return _mm_castsi128_ps(mask);
+}
+
+// Четыре ячейки за шаг: веса - двумя регистрами, их маски сжимаются до 32-битных дорожек предыдущих ребер
+__attribute__((target("sse4.2")))
+void RelaxRowSse42(int64_t from_weight, const int64_t* through_weights, const uint32_t* through_prev_edges,
+                   int64_t* weights, uint32_t* prev_edges, size_t count) {
+    const __m128i from = _mm_set1_epi64x(from_weight);
+    const __m128i infinity = _mm_set1_epi64x(INFINITE_WEIGHT);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128i through_prev = _mm_loadu_si128(reinterpret_cast<const __m128i*>(through_prev_edges + i));
+        const __m128i current_prev = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev_edges + i));
+        const __m128i prev_less = LessUnsigned(through_prev, current_prev);
+        const __m128 low_mask = RelaxPairSse42(from, infinity, _mm_cvtepi32_epi64(prev_less), through_weights + i, weights + i);
+        const __m128 high_mask = RelaxPairSse42(from, infinity, _mm_cvtepi32_epi64(_mm_srli_si128(prev_less, 8)),
+                                                through_weights + i + 2, weights + i + 2);
+        const __m128i mask = _mm_castps_si128(_mm_shuffle_ps(low_mask, high_mask, _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(prev_edges + i), _mm_blendv_epi8(current_prev, through_prev, mask));
+    }
+    RelaxRowScalar(from_weight, through_weights + i, through_prev_edges + i, weights + i, prev_edges + i, count - i);
+}
+
+__attribute__((target("avx2")))
+void RelaxRowAvx2(int64_t from_weight, const int64_t* through_weights, const uint32_t* through_prev_edges,
+                  int64_t* weights, uint32_t* prev_edges, size_t count) {
+    const __m256i from = _mm256_set1_epi64x(from_weight);
+    const __m256i infinity = _mm256_set1_epi64x(INFINITE_WEIGHT);
+    const __m256i low_halves = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128i through_prev = _mm_loadu_si128(reinterpret_cast<const __m128i*>(through_prev_edges + i));
+        const __m128i current_prev = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev_edges + i));
+        const __m256i prev_less = _mm256_cvtepi32_epi64(LessUnsigned(through_prev, current_prev));
+
+        const __m256i through = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(through_weights + i));
+        const __m256i current = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(weights + i));
+        const __m256i candidate = _mm256_add_epi64(from, through);
+        const __m256i better = _mm256_or_si256(_mm256_cmpgt_epi64(current, candidate),
+                                               _mm256_and_si256(_mm256_cmpeq_epi64(current, candidate), prev_less));
+        const __m256i mask = _mm256_andnot_si256(_mm256_cmpeq_epi64(through, infinity), better);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(weights + i), _mm256_blendv_epi8(current, candidate, mask));
+
+        const __m128i prev_mask = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(mask, low_halves));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(prev_edges + i), _mm_blendv_epi8(current_prev, through_prev, prev_mask));
+    }
+    RelaxRowScalar(from_weight, through_weights + i, through_prev_edges + i, weights + i, prev_edges + i, count - i);
+}
+
+#endif
+
+RelaxRowKernel SelectRelaxRowKernel() {
+#ifdef RELAX_KERNEL_X86
+    if (__builtin_cpu_supports("avx2")) {
+        return {RelaxRowAvx2, "avx2"};
+    }
+    if (__builtin_cpu_supports("sse4.2")) {
+        return {RelaxRowSse42, "sse4.2"};
+    }
+#endif
+    return {RelaxRowScalar, "scalar"};
+}
+
+const RelaxRowKernel& GetRelaxRowKernel() {
+    static const RelaxRowKernel kernel = SelectRelaxRowKernel();
+    return kernel;
+}
+
+}  // namespace
+
+void RelaxRow(int64_t from_weight, const int64_t* through_weights, const uint32_t* through_prev_edges,
+              int64_t* weights, uint32_t* prev_edges, size_t count) {
+    GetRelaxRowKernel().function(from_weight, through_weights, through_prev_edges, weights, prev_edges, count);
+}
+
+const char* GetRelaxRowKernelName() {
+    return GetRelaxRowKernel().name;
+}
+
+std::vector<RelaxRowKernel> GetSupportedRelaxRowKernels() {
+    std::vector<RelaxRowKernel> kernels{{RelaxRowScalar, "scalar"}};
+#ifdef RELAX_KERNEL_X86
+    if (__builtin_cpu_supports("sse4.2")) {
+        kernels.push_back({RelaxRowSse42, "sse4.2"});
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        kernels.push_back({RelaxRowAvx2, "avx2"});
+    }
+#endif
+    return kernels;
+}
+
+}  // namespace details
+
+}  // namespace graph
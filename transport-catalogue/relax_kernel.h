@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+namespace graph {
+
+namespace details {
+
+// Шаг min-plus релаксации строки таблицы маршрутов через промежуточную вершину:
+// weights[j] = min(weights[j], from_weight + through_weights[j]), при улучшении
+// prev_edges[j] = through_prev_edges[j]. При равном весе выигрывает меньшее предыдущее ребро,
+// поэтому результат не зависит от порядка релаксаций. Недостижимость - вес INT64_MAX, такие ячейки
+// строки through не релаксируют. Реализация (AVX2, SSE4.2 или скалярная) выбирается
+// один раз по возможностям процессора
+void RelaxRow(int64_t from_weight, const int64_t* through_weights, const uint32_t* through_prev_edges,
+              int64_t* weights, uint32_t* prev_edges, size_t count);
+
+// Название выбранной реализации RelaxRow: "avx2", "sse4.2" или "scalar"
+const char* GetRelaxRowKernelName();
+
+using RelaxRowFunction = void (*)(int64_t, const int64_t*, const uint32_t*, int64_t*, uint32_t*, size_t);
+
+struct RelaxRowKernel {
+    RelaxRowFunction function;
+    const char* name;
+};
+
+// Все реализации RelaxRow, которые может исполнить процессор, скалярная первой. Нужны тестам,
+// чтобы сверить со скалярной и те векторные, что RelaxRow на этом процессоре не выбирает
+std::vector<RelaxRowKernel> GetSupportedRelaxRowKernels();
+
+}  // namespace details
+
+}  // namespace graph
@@ -3,6 +3,7 @@
 #include "transport_router.h"
 #include "request_handler.h"
 #include "domain.h"
+#include "parallel.h"
 
 RequestHandler::RequestHandler(transport_catalogue::TransportCatalogue& catalogue, renderer::MapRenderer& renderer, transport_router::TransportRouter& router) : db_(catalogue), renderer_(renderer), router_(router){}
 
@@ -18,6 +19,31 @@ void RequestHandler::AddDistance(const std::string &stop_from, const std::string
     db_.AddDistance(stop_from, stop_to, distance);
 }
 
+void RequestHandler::Finalize(){
+    db_.Finalize(parallel::DefaultThreadCount());
+}
+
+transport_router::BusUpdateStats RequestHandler::HotAddBus(const std::string& name, const std::vector<std::string_view>& stops_name, bool is_round){
+    db_.AddBus(name, stops_name, is_round);
+    db_.FinalizeNewBuses(parallel::DefaultThreadCount());
+    return router_.AddBus(name);
+}
+
+void RequestHandler::HotUpdateStop(const std::string& name, geo::Coordinates coord, const std::vector<transport_catalogue::DistanceToStop>& distances){
+    if(db_.FindStop(name) == nullptr){
+        db_.AddStop(name, coord);
+    }
+    for(const auto& [stop_to, distance] : distances){
+        db_.AddDistance(name, stop_to, distance);
+    }
+    db_.FinalizeNewBuses(parallel::DefaultThreadCount());
+    router_.UpdateDistances();
+}
+
+const transport_catalogue::FinalizeStats& RequestHandler::GetFinalizeStats() const{
+    return db_.GetFinalizeStats();
+}
+
 const Stop* RequestHandler::FindStop(std::string_view name) const{
     return db_.FindStop(name);
 }
@@ -70,14 +96,57 @@ std::stringstream RequestHandler::RenderMap() const{
     return ss;
 }
 
-void RequestHandler::CreateRoute(int bus_wait_time, double bus_velocity){
-    router_.SetRoutingSettings(bus_wait_time, bus_velocity);
+void RequestHandler::CreateRoute(const transport_router::RoutingSettings& settings){
+    //Граф строится при первом запросе маршрута
+    router_.SetRoutingSettings(settings);
+}
+
+void RequestHandler::BuildRoute(){
     router_.CreateGraph();
 }
 
-transport_router::RouteInfo RequestHandler::GetRoute(std::string_view from, std::string_view to) const{
+transport_router::RouterStats RequestHandler::GetRouterStats() const{
+    return router_.GetStats();
+}
+
+bool RequestHandler::HasRoutingProfile(std::string_view profile) const{
+    return router_.HasProfile(profile);
+}
+
+transport_router::RouteInfo RequestHandler::GetRoute(std::string_view from, std::string_view to, std::string_view profile) const{
     if(from == to){
         return transport_router::RouteInfo{0, {}};
     }
-    return router_.GetRoute(from, to);
+    return router_.GetRoute(from, to, profile);
+}
+
+std::vector<transport_router::RouteInfo> RequestHandler::GetRoutes(const std::vector<std::pair<std::string_view, std::string_view>>& pairs,
+                                                                   std::string_view profile) const{
+    // Маршрут из остановки в нее же пустой, такие пары роутеру не передаются
+    std::vector<std::pair<std::string_view, std::string_view>> searched_pairs;
+    std::vector<size_t> searched_indices;
+    for(size_t i = 0; i < pairs.size(); i++){
+        if(pairs[i].first != pairs[i].second){
+            searched_pairs.push_back(pairs[i]);
+            searched_indices.push_back(i);
+        }
+    }
+    std::vector<transport_router::RouteInfo> routes(pairs.size(), transport_router::RouteInfo{0, {}});
+    if(searched_pairs.empty()){
+        return routes;
+    }
+    std::vector<transport_router::RouteInfo> found = router_.GetRoutes(searched_pairs, profile);
+    for(size_t i = 0; i < found.size(); i++){
+        routes[searched_indices[i]] = std::move(found[i]);
+    }
+    return routes;
+}
+
+transport_router::TravelTimeMatrix RequestHandler::GetMatrix(const std::vector<std::string_view>& from_stops, const std::vector<std::string_view>& to_stops,
+                                                             std::string_view profile) const{
+    return router_.GetMatrix(from_stops, to_stops, profile);
+}
+
+std::vector<transport_router::ReachableStop> RequestHandler::GetReachable(std::string_view from, double max_time, std::string_view profile) const{
+    return router_.GetReachable(from, max_time, profile);
 }
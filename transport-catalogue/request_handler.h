@@ -6,6 +6,8 @@
 #include "map_renderer.h"
 
 #include <optional>
+#include <utility>
+#include <vector>
 
 class RequestHandler {
 public:
@@ -14,6 +16,15 @@ public:
     void AddStop(const std::string& name, geo::Coordinates coord);
     void AddBus(const std::string &name, const std::vector<std::string_view> &stops_name, bool is_round);
     void AddDistance(const std::string &stop_from, const std::string &stop_to, int distance);
+    // Вызывается после загрузки базовых запросов
+    void Finalize();
+    // Добавляет автобус после построения роутера: справочник досчитывает сведения только нового автобуса,
+    // роутер обновляется без полного построения, если движок позволяет
+    transport_router::BusUpdateStats HotAddBus(const std::string& name, const std::vector<std::string_view>& stops_name, bool is_round);
+    // Добавляет остановку, если ее еще нет, и расстояния от нее. Новое расстояние меняет длины прежних
+    // автобусов: справочник считает сведения заново, построенный роутер перестраивается
+    void HotUpdateStop(const std::string& name, geo::Coordinates coord, const std::vector<transport_catalogue::DistanceToStop>& distances);
+    const transport_catalogue::FinalizeStats& GetFinalizeStats() const;
 
     const Stop* FindStop(std::string_view name) const;
     const Bus* FindBus(std::string_view name) const;
@@ -33,8 +44,22 @@ public:
     std::stringstream RenderMap() const;
 
     void SetRoutingSettings(int bus_wait_time, double bus_velocity);
-    void CreateRoute(int bus_wait_time, double bus_velocity);
-    transport_router::RouteInfo GetRoute(std::string_view from, std::string_view to) const;
+    void CreateRoute(const transport_router::RoutingSettings& settings);
+    // Строит роутер сразу, не дожидаясь первого запроса маршрута. Можно вызывать в фоновом потоке,
+    // пока отвечаются запросы к справочнику и карте
+    void BuildRoute();
+    // Запросы к роутеру принимают имя профиля маршрутизации, пустое - основной профиль
+    bool HasRoutingProfile(std::string_view profile) const;
+    transport_router::RouteInfo GetRoute(std::string_view from, std::string_view to, std::string_view profile = {}) const;
+    // Маршруты для пакета пар (from, to) в порядке пар, см. TransportRouter::GetRoutes
+    std::vector<transport_router::RouteInfo> GetRoutes(const std::vector<std::pair<std::string_view, std::string_view>>& pairs,
+                                                       std::string_view profile = {}) const;
+    // Матрица времен в пути между остановками, см. TransportRouter::GetMatrix
+    transport_router::TravelTimeMatrix GetMatrix(const std::vector<std::string_view>& from_stops, const std::vector<std::string_view>& to_stops,
+                                                 std::string_view profile = {}) const;
+    // Остановки, достижимые из from за max_time минут, см. TransportRouter::GetReachable
+    std::vector<transport_router::ReachableStop> GetReachable(std::string_view from, double max_time, std::string_view profile = {}) const;
+    transport_router::RouterStats GetRouterStats() const;
 
 private:
     // RequestHandler использует агрегацию объектов "Транспортный Справочник" и "Визуализатор Карты"
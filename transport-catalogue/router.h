@@ -1,13 +1,18 @@
 #pragma once
 
 #include "graph.h"
+#include "parallel.h"
+#include "relax_kernel.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cstdint>
 #include <iterator>
+#include <limits>
 #include <optional>
 #include <stdexcept>
+#include <type_traits>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -21,14 +26,25 @@ private:
 
 public:
     Router() = default;
-    explicit Router(Graph graph);
+    // thread_count - число потоков блочного Флойда-Уоршелла, результат от него не зависит
+    explicit Router(Graph graph, size_t thread_count = 1);
 
     struct RouteInfo {
         Weight weight;
         std::vector<EdgeId> edges;
     };
 
+    // Из нескольких кратчайших путей возвращается канонический: последнее ребро - наименьшее
+    // по EdgeId среди ребер, которыми кончаются кратчайшие пути в to, и так же до from
     std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
+    // Добавляет ребра в граф и обновляет таблицу без повторного Флойда-Уоршелла: для ребра (u, v)
+    // каждая строка i, в которой путь i -> u -> v короче известного пути в v, релаксируется строкой v.
+    // O(V^2) на ребро в худшем случае, строки одного ребра считаются параллельно.
+    // Возвращает число релаксированных строк
+    size_t AddEdges(const std::vector<Edge<Weight>>& edges, size_t thread_count = 1);
+
+    // Объем таблицы маршрутов для графа с vertex_count вершинами
+    static size_t EstimateMemory(size_t vertex_count);
 
     graph::DirectedWeightedGraph<Weight>& GetGraph(){
         return graph_;
@@ -39,88 +55,228 @@ public:
     }
 
 private:
-    struct RouteInternalData {
-        Weight weight;
-        std::optional<EdgeId> prev_edge;
-    };
-    using RoutesInternalData = std::vector<std::vector<std::optional<RouteInternalData>>>;
+    // Предыдущее ребро хранится в 32 битах. Целые веса таблица хранит как есть: на int64_t это
+    // 12 байт на ячейку, зато суммы точны и найденный путь кратчайший без погрешности.
+    // Вещественные веса сжимаются до float - 8 байт на ячейку, но из близких в double путей
+    // может быть выбран не самый короткий. Недостижимость обозначается бесконечным (максимальным) весом,
+    // отсутствие ребра - NO_PREV_EDGE. Вес маршрута пересчитывается в BuildRoute по ребрам графа
+    using StoredWeight = std::conditional_t<std::is_floating_point_v<Weight>, float, Weight>;
+    static constexpr StoredWeight INFINITE_WEIGHT = std::numeric_limits<StoredWeight>::has_infinity
+                                                        ? std::numeric_limits<StoredWeight>::infinity()
+                                                        : std::numeric_limits<StoredWeight>::max();
+    static constexpr uint32_t NO_PREV_EDGE = std::numeric_limits<uint32_t>::max();
+
+    // Веса и предыдущие ребра лежат в двух отдельных массивах (structure of arrays), чтобы строки
+    // релаксировались векторными инструкциями. Ячейка (from, to) - индекс from * vertex_count_ + to
+    size_t GetCellIndex(VertexId from, VertexId to) const {
+        return from * vertex_count_ + to;
+    }
 
     void InitializeRoutesInternalData(const Graph& graph) {
-        const size_t vertex_count = graph.GetVertexCount();
-        for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
-            routes_internal_data_[vertex][vertex] = RouteInternalData{ZERO_WEIGHT, std::nullopt};
+        if (graph.GetEdgeCount() >= NO_PREV_EDGE) {
+            throw std::length_error("Too many edges for the all-pairs router");
+        }
+        for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) {
+            weights_[GetCellIndex(vertex, vertex)] = StoredWeight{};
             for (const EdgeId edge_id : graph.GetIncidentEdges(vertex)) {
                 const auto& edge = graph.GetEdge(edge_id);
                 if (edge.weight < ZERO_WEIGHT) {
                     throw std::domain_error("Edges' weights should be non-negative");
                 }
-                auto& route_internal_data = routes_internal_data_[vertex][edge.to];
-                if (!route_internal_data || route_internal_data->weight > edge.weight) {
-                    route_internal_data = RouteInternalData{edge.weight, edge_id};
+                const size_t cell = GetCellIndex(vertex, edge.to);
+                const auto edge_weight = static_cast<StoredWeight>(edge.weight);
+                if (weights_[cell] > edge_weight) {
+                    weights_[cell] = edge_weight;
+                    prev_edges_[cell] = static_cast<uint32_t>(edge_id);
                 }
             }
         }
     }
 
-    void RelaxRoute(VertexId vertex_from, VertexId vertex_to, const RouteInternalData& route_from,
-                    const RouteInternalData& route_to) {
-        auto& route_relaxing = routes_internal_data_[vertex_from][vertex_to];
-        const Weight candidate_weight = route_from.weight + route_to.weight;
-        if (!route_relaxing || candidate_weight < route_relaxing->weight) {
-            route_relaxing = {candidate_weight,
-                              route_to.prev_edge ? route_to.prev_edge : route_from.prev_edge};
+    // Из равных по весу путей остается путь с меньшим последним ребром. У ячейки (through, through)
+    // предыдущее ребро NO_PREV_EDGE больше любого, поэтому путь через нее не выигрывает и при равенстве
+    static void RelaxRow(StoredWeight from_weight, const StoredWeight* through_weights, const uint32_t* through_prev_edges,
+                         StoredWeight* weights, uint32_t* prev_edges, size_t count) {
+        if constexpr (std::is_same_v<StoredWeight, int64_t>) {
+            details::RelaxRow(from_weight, through_weights, through_prev_edges, weights, prev_edges, count);
+        } else {
+            for (size_t i = 0; i < count; ++i) {
+                if (through_weights[i] == INFINITE_WEIGHT) {
+                    continue;
+                }
+                const StoredWeight candidate_weight = from_weight + through_weights[i];
+                if (candidate_weight < weights[i] || (candidate_weight == weights[i] && through_prev_edges[i] < prev_edges[i])) {
+                    weights[i] = candidate_weight;
+                    prev_edges[i] = through_prev_edges[i];
+                }
+            }
         }
     }
 
-    void RelaxRoutesInternalDataThroughVertex(size_t vertex_count, VertexId vertex_through) {
-        for (VertexId vertex_from = 0; vertex_from < vertex_count; ++vertex_from) {
-            if (const auto& route_from = routes_internal_data_[vertex_from][vertex_through]) {
-                for (VertexId vertex_to = 0; vertex_to < vertex_count; ++vertex_to) {
-                    if (const auto& route_to = routes_internal_data_[vertex_through][vertex_to]) {
-                        RelaxRoute(vertex_from, vertex_to, *route_from, *route_to);
-                    }
+    // Релаксирует блок [from_begin, from_end) x [to_begin, to_end) через вершины [through_begin, through_end).
+    // Цикл по промежуточной вершине внешний, поэтому блок может пересекаться с блоками-источниками
+    void RelaxBlock(VertexId from_begin, VertexId from_end, VertexId to_begin, VertexId to_end,
+                    VertexId through_begin, VertexId through_end) {
+        for (VertexId vertex_through = through_begin; vertex_through < through_end; ++vertex_through) {
+            const size_t through_row = GetCellIndex(vertex_through, to_begin);
+            for (VertexId vertex_from = from_begin; vertex_from < from_end; ++vertex_from) {
+                const StoredWeight from_weight = weights_[GetCellIndex(vertex_from, vertex_through)];
+                if (from_weight == INFINITE_WEIGHT) {
+                    continue;
                 }
+                const size_t from_row = GetCellIndex(vertex_from, to_begin);
+                RelaxRow(from_weight, &weights_[through_row], &prev_edges_[through_row],
+                         &weights_[from_row], &prev_edges_[from_row], to_end - to_begin);
             }
         }
     }
 
+    // Блочный Флойд-Уоршелл. Для каждого диагонального блока k: сам блок, затем блоки его строки
+    // и столбца, затем все остальные. Внутри фазы блоки не зависят друг от друга и считаются
+    // параллельно. Ячейка сходится к весу кратчайшего пути и наименьшему последнему ребру среди
+    // кратчайших путей - это не зависит от порядка релаксаций, поэтому результат одинаков при любом
+    // числе потоков и совпадает с последовательным Флойдом-Уоршеллом
+    void RelaxRoutesInternalData(size_t thread_count) {
+        const size_t block_count = (vertex_count_ + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        const auto block_begin = [](size_t block) {
+            return block * BLOCK_SIZE;
+        };
+        const auto block_end = [this](size_t block) {
+            return std::min(vertex_count_, (block + 1) * BLOCK_SIZE);
+        };
+        parallel::WorkerPool pool(thread_count);
+
+        for (size_t k = 0; k < block_count; ++k) {
+            const VertexId through_begin = block_begin(k);
+            const VertexId through_end = block_end(k);
+            RelaxBlock(through_begin, through_end, through_begin, through_end, through_begin, through_end);
+
+            pool.ForEachChunk(2 * block_count, [&](size_t begin, size_t end) {
+                for (size_t task = begin; task < end; ++task) {
+                    const size_t block = task % block_count;
+                    if (block == k) {
+                        continue;
+                    }
+                    if (task < block_count) {
+                        RelaxBlock(through_begin, through_end, block_begin(block), block_end(block), through_begin, through_end);
+                    } else {
+                        RelaxBlock(block_begin(block), block_end(block), through_begin, through_end, through_begin, through_end);
+                    }
+                }
+            });
+
+            pool.ForEachChunk(block_count, [&](size_t begin, size_t end) {
+                for (size_t row = begin; row < end; ++row) {
+                    if (row == k) {
+                        continue;
+                    }
+                    for (size_t column = 0; column < block_count; ++column) {
+                        if (column != k) {
+                            RelaxBlock(block_begin(row), block_end(row), block_begin(column), block_end(column),
+                                       through_begin, through_end);
+                        }
+                    }
+                }
+            });
+        }
+    }
+
+    static constexpr size_t BLOCK_SIZE = 64;
     static constexpr Weight ZERO_WEIGHT{};
     Graph graph_;
-    RoutesInternalData routes_internal_data_;
+    size_t vertex_count_ = 0;
+    std::vector<StoredWeight> weights_;
+    std::vector<uint32_t> prev_edges_;
 };
 
 template <typename Weight>
-Router<Weight>::Router(Graph graph)
-    : graph_(graph)
-    , routes_internal_data_(graph.GetVertexCount(),
-                            std::vector<std::optional<RouteInternalData>>(graph.GetVertexCount()))
+Router<Weight>::Router(Graph graph, size_t thread_count)
+    : graph_(std::move(graph))
+    , vertex_count_(graph_.GetVertexCount())
+    , weights_(vertex_count_ * vertex_count_, INFINITE_WEIGHT)
+    , prev_edges_(vertex_count_ * vertex_count_, NO_PREV_EDGE)
 {
-    InitializeRoutesInternalData(graph);
+    graph_.Freeze();
+    InitializeRoutesInternalData(graph_);
+    RelaxRoutesInternalData(thread_count);
+}
 
-    const size_t vertex_count = graph.GetVertexCount();
-    for (VertexId vertex_through = 0; vertex_through < vertex_count; ++vertex_through) {
-        RelaxRoutesInternalDataThroughVertex(vertex_count, vertex_through);
-    }
+template <typename Weight>
+size_t Router<Weight>::EstimateMemory(size_t vertex_count) {
+    return vertex_count * vertex_count * (sizeof(StoredWeight) + sizeof(uint32_t));
 }
 
 template <typename Weight>
 std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRoute(VertexId from,
                                                                              VertexId to) const {
-    const auto& route_internal_data = routes_internal_data_.at(from).at(to);
-    if (!route_internal_data) {
+    if (from >= vertex_count_ || to >= vertex_count_) {
+        throw std::out_of_range("vertex is out of range");
+    }
+    if (weights_[GetCellIndex(from, to)] == INFINITE_WEIGHT) {
         return std::nullopt;
     }
-    const Weight weight = route_internal_data->weight;
+    Weight weight = ZERO_WEIGHT;
     std::vector<EdgeId> edges;
-    for (std::optional<EdgeId> edge_id = route_internal_data->prev_edge;
-         edge_id;
-         edge_id = routes_internal_data_[from][graph_.GetEdge(*edge_id).from]->prev_edge)
+    for (uint32_t edge_id = prev_edges_[GetCellIndex(from, to)];
+         edge_id != NO_PREV_EDGE;
+         edge_id = prev_edges_[GetCellIndex(from, graph_.GetEdge(edge_id).from)])
     {
-        edges.push_back(*edge_id);
+        edges.push_back(edge_id);
+        weight += graph_.GetEdge(edge_id).weight;
     }
     std::reverse(edges.begin(), edges.end());
 
     return RouteInfo{weight, std::move(edges)};
 }
 
-}  // namespace graph
\ No newline at end of file
+template <typename Weight>
+size_t Router<Weight>::AddEdges(const std::vector<Edge<Weight>>& edges, size_t thread_count) {
+    if (graph_.GetEdgeCount() + edges.size() >= NO_PREV_EDGE) {
+        throw std::length_error("Too many edges for the all-pairs router");
+    }
+    for (const auto& edge : edges) {
+        if (edge.from >= vertex_count_ || edge.to >= vertex_count_) {
+            throw std::out_of_range("vertex is out of range");
+        }
+        if (edge.weight < ZERO_WEIGHT) {
+            throw std::domain_error("Edges' weights should be non-negative");
+        }
+    }
+    const EdgeId first_id = graph_.AppendEdges(edges);
+
+    // Строка v не меняется: путь v -> u -> v не короче нулевого, поэтому ее читают все потоки
+    std::atomic<size_t> relaxed_rows{0};
+    parallel::WorkerPool pool(thread_count);
+    for (size_t i = 0; i < edges.size(); ++i) {
+        const Edge<Weight>& edge = edges[i];
+        const auto edge_weight = static_cast<StoredWeight>(edge.weight);
+        const auto edge_id = static_cast<uint32_t>(first_id + i);
+        const size_t through_row = GetCellIndex(edge.to, 0);
+        pool.ForEachChunk(vertex_count_, [&](size_t begin, size_t end) {
+            size_t rows = 0;
+            for (VertexId vertex_from = begin; vertex_from < end; ++vertex_from) {
+                const StoredWeight from_weight = weights_[GetCellIndex(vertex_from, edge.from)];
+                if (from_weight == INFINITE_WEIGHT) {
+                    continue;
+                }
+                // Если путь в v через ребро не короче, то по неравенству треугольника не короче и пути через v дальше.
+                // Равный путь ничего не меняет: EdgeId нового ребра больше прежних, а дальше v пути те же
+                const StoredWeight candidate_weight = from_weight + edge_weight;
+                const size_t cell = GetCellIndex(vertex_from, edge.to);
+                if (!(candidate_weight < weights_[cell])) {
+                    continue;
+                }
+                weights_[cell] = candidate_weight;
+                prev_edges_[cell] = edge_id;
+                const size_t from_row = GetCellIndex(vertex_from, 0);
+                RelaxRow(candidate_weight, &weights_[through_row], &prev_edges_[through_row],
+                         &weights_[from_row], &prev_edges_[from_row], vertex_count_);
+                ++rows;
+            }
+            relaxed_rows += rows;
+        });
+    }
+    return relaxed_rows;
+}
+
+}  // namespace graph
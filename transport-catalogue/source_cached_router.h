@@ -0,0 +1,128 @@
+#pragma once
+
+#include "graph.h"
+#include "dijkstra_router.h"
+
+#include <limits>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+namespace graph {
+
+// Счетчики кэша деревьев: обращения, вытеснения и текущий объем
+struct SourceCacheStats {
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t evictions = 0;
+    size_t tree_count = 0;
+    size_t bytes = 0;
+};
+
+// Запускает один полный поиск на каждую различную начальную вершину и хранит
+// полученные деревья кратчайших путей. Выгоден, когда запросы сгруппированы по началу.
+// Деревья вытесняются в порядке давности использования (LRU), чтобы их суммарный объем
+// не превышал cache_bytes. Дерево, которое не помещается в бюджет само по себе, не кэшируется.
+// Деревья строит Дейкстра: иерархия сжатия и метки хабов отвечают на запросы пар и дерева не строят
+template <typename Weight>
+class SourceCachedRouter {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+    using Tree = ShortestPathTree<Weight>;
+
+public:
+    using RouteInfo = typename Router<Weight>::RouteInfo;
+
+    SourceCachedRouter() = default;
+    explicit SourceCachedRouter(Graph graph, size_t cache_bytes = std::numeric_limits<size_t>::max())
+        : router_(std::move(graph))
+        , cache_bytes_(cache_bytes) {
+        if (router_.GetGraph().GetEdgeCount() >= Tree::NO_TREE_EDGE) {
+            throw std::length_error("Too many edges for shortest path trees");
+        }
+    }
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const {
+        return GetTree(from)->BuildRoute(to, router_.GetGraph());
+    }
+
+    // Маршруты из from во все targets по одному дереву: одно обращение к кэшу на всю группу
+    std::vector<std::optional<RouteInfo>> BuildRoutes(VertexId from, const std::vector<VertexId>& targets) const {
+        const std::shared_ptr<const Tree> tree = GetTree(from);
+        std::vector<std::optional<RouteInfo>> routes;
+        routes.reserve(targets.size());
+        for (const VertexId to : targets) {
+            routes.push_back(tree->BuildRoute(to, router_.GetGraph()));
+        }
+        return routes;
+    }
+
+    SourceCacheStats GetCacheStats() const {
+        std::lock_guard guard(mutex_);
+        return stats_;
+    }
+
+    graph::DirectedWeightedGraph<Weight>& GetGraph() {
+        return router_.GetGraph();
+    }
+
+    const graph::DirectedWeightedGraph<Weight>& GetGraph() const {
+        return router_.GetGraph();
+    }
+
+private:
+    struct CacheEntry {
+        VertexId root;
+        std::shared_ptr<const Tree> tree;
+    };
+
+    std::shared_ptr<const Tree> GetTree(VertexId from) const {
+        {
+            std::lock_guard guard(mutex_);
+            if (auto it = index_.find(from); it != index_.end()) {
+                ++stats_.hits;
+                entries_.splice(entries_.begin(), entries_, it->second);
+                return it->second->tree;
+            }
+            ++stats_.misses;
+        }
+        // Поиск идет без блокировки, чтобы разные начальные вершины считались параллельно.
+        // Дерево удерживается shared_ptr, поэтому вытеснение не мешает уже идущим запросам
+        auto tree = std::make_shared<const Tree>(router_.BuildShortestPathTree(from));
+        const size_t tree_bytes = tree->GetMemoryBytes();
+        if (tree_bytes > cache_bytes_) {
+            return tree;
+        }
+
+        std::lock_guard guard(mutex_);
+        if (auto it = index_.find(from); it != index_.end()) {
+            return it->second->tree;
+        }
+        while (stats_.bytes + tree_bytes > cache_bytes_) {
+            const CacheEntry& oldest = entries_.back();
+            stats_.bytes -= oldest.tree->GetMemoryBytes();
+            index_.erase(oldest.root);
+            entries_.pop_back();
+            ++stats_.evictions;
+        }
+        entries_.push_front({from, tree});
+        index_[from] = entries_.begin();
+        stats_.bytes += tree_bytes;
+        stats_.tree_count = entries_.size();
+        return tree;
+    }
+
+    DijkstraRouter<Weight> router_;
+    size_t cache_bytes_ = std::numeric_limits<size_t>::max();
+    mutable std::mutex mutex_;
+    // Начало списка - последнее использованное дерево
+    mutable std::list<CacheEntry> entries_;
+    mutable std::unordered_map<VertexId, typename std::list<CacheEntry>::iterator> index_;
+    mutable SourceCacheStats stats_;
+};
+
+}  // namespace graph
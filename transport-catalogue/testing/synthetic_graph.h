@@ -0,0 +1,38 @@
+#pragma once
+
+#include "graph.h"
+#include "synthetic_network.h"
+
+#include <cstdint>
+#include <vector>
+
+// Случайные графы для тестов движков маршрутизации. Веса берутся из малого диапазона,
+// чтобы у многих пар вершин было несколько кратчайших путей
+namespace synthetic {
+
+struct GraphOptions {
+    size_t vertex_count = 100;
+    size_t edge_count = 400;
+    // Вес ребра - weight_offset плюс случайное от 1 до max_weight
+    int64_t max_weight = 4;
+    int64_t weight_offset = 0;
+    uint32_t seed = 1;
+};
+
+inline graph::DirectedWeightedGraph<int64_t> MakeRandomGraph(const GraphOptions& options) {
+    Random random(options.seed);
+    std::vector<graph::Edge<int64_t>> edges;
+    edges.reserve(options.edge_count);
+    while (edges.size() < options.edge_count) {
+        const size_t from = random.Below(options.vertex_count);
+        const size_t to = random.Below(options.vertex_count);
+        if (from == to) {
+            continue;
+        }
+        const auto weight = static_cast<int64_t>(1 + random.Below(static_cast<size_t>(options.max_weight)));
+        edges.emplace_back(from, to, options.weight_offset + weight);
+    }
+    return graph::DirectedWeightedGraph<int64_t>(options.vertex_count, std::move(edges));
+}
+
+}  // namespace synthetic
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "transport_catalogue.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Синтетические сети для тестов и бенчмарков: остановки в узлах квадратной сетки,
+// автобусы - случайные блуждания по соседним узлам. Сеть зависит только от параметров
+namespace synthetic {
+
+struct NetworkOptions {
+    size_t stop_count = 1000;
+    size_t bus_count = 100;
+    // Остановок в маршруте автобуса, у кольцевого - без повтора первой в конце
+    size_t stops_per_bus = 10;
+    uint32_t seed = 1;
+};
+
+// xorshift32: одинаковая последовательность на любой стандартной библиотеке
+class Random {
+public:
+    explicit Random(uint32_t seed) : state_(seed * 2654435761u | 1u) {}
+
+    uint32_t Next() {
+        state_ ^= state_ << 13;
+        state_ ^= state_ >> 17;
+        state_ ^= state_ << 5;
+        return state_;
+    }
+
+    size_t Below(size_t bound) {
+        return Next() % bound;
+    }
+
+private:
+    uint32_t state_;
+};
+
+inline std::string StopName(size_t stop) {
+    return "Stop " + std::to_string(stop);
+}
+
+inline std::string BusName(size_t bus) {
+    return "Bus " + std::to_string(bus);
+}
+
+// Заполняет пустой справочник и вызывает Finalize. Каждый третий автобус кольцевой.
+// Расстояние задается на каждый перегон в направлении движения: 400-800 м на шаг сетки
+inline void FillCatalogue(transport_catalogue::TransportCatalogue& catalogue, const NetworkOptions& options) {
+    const size_t side = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(options.stop_count))));
+    std::vector<std::string> names;
+    names.reserve(options.stop_count);
+    for (size_t stop = 0; stop < options.stop_count; ++stop) {
+        names.push_back(StopName(stop));
+        catalogue.AddStop(names.back(), {55.0 + 0.004 * static_cast<double>(stop / side), 37.0 + 0.006 * static_cast<double>(stop % side)});
+    }
+
+    Random random(options.seed);
+    const auto grid_distance = [side](size_t from, size_t to) {
+        const long rows = static_cast<long>(from / side) - static_cast<long>(to / side);
+        const long columns = static_cast<long>(from % side) - static_cast<long>(to % side);
+        return static_cast<int>(std::labs(rows) + std::labs(columns));
+    };
+    for (size_t bus = 0; bus < options.bus_count; ++bus) {
+        std::vector<size_t> route{random.Below(options.stop_count)};
+        while (route.size() < options.stops_per_bus) {
+            const size_t current = route.back();
+            std::vector<size_t> neighbours;
+            if (current >= side) {
+                neighbours.push_back(current - side);
+            }
+            if (current + side < options.stop_count) {
+                neighbours.push_back(current + side);
+            }
+            if (current % side > 0) {
+                neighbours.push_back(current - 1);
+            }
+            if (current % side + 1 < side && current + 1 < options.stop_count) {
+                neighbours.push_back(current + 1);
+            }
+            if (neighbours.empty()) {
+                break;
+            }
+            // Без разворота назад, если есть куда свернуть
+            if (route.size() > 1 && neighbours.size() > 1) {
+                const size_t previous = route[route.size() - 2];
+                neighbours.erase(std::remove(neighbours.begin(), neighbours.end(), previous), neighbours.end());
+            }
+            route.push_back(neighbours[random.Below(neighbours.size())]);
+        }
+        const bool is_round = bus % 3 == 0;
+        if (is_round) {
+            route.push_back(route.front());
+        }
+        for (size_t i = 0; i + 1 < route.size(); ++i) {
+            const int steps = std::max(1, grid_distance(route[i], route[i + 1]));
+            catalogue.AddDistance(names[route[i]], names[route[i + 1]], steps * (400 + static_cast<int>(random.Below(400))));
+        }
+        std::vector<std::string_view> stops;
+        stops.reserve(route.size());
+        for (const size_t stop : route) {
+            stops.push_back(names[stop]);
+        }
+        catalogue.AddBus(BusName(bus), stops, is_round);
+    }
+    catalogue.Finalize();
+}
+
+}  // namespace synthetic
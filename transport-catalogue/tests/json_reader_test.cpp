@@ -0,0 +1,223 @@
+#include "json.h"
+#include "json_reader.h"
+#include "map_renderer.h"
+#include "request_handler.h"
+#include "transport_catalogue.h"
+#include "transport_router.h"
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+// Полный цикл обработки, как в main: запросы из input, напечатанный ответ на stat_requests.
+// background - строить ли роутер в фоновом потоке независимо от числа ядер
+std::string ProcessToText(const std::string& input, bool background) {
+    transport_catalogue::TransportCatalogue catalogue;
+    renderer::MapRenderer renderer;
+    transport_router::TransportRouter router(catalogue);
+    RequestHandler request_handler(catalogue, renderer, router);
+    json_reader::JsonReader reader(request_handler);
+
+    std::istringstream in(input);
+    reader.ReadRequests(in);
+    reader.HandleBaseRequests();
+    reader.HandleRoutingSettings();
+    reader.HandleUpdateRequests();
+    reader.StartRouterBuild(background);
+    reader.HandleRenderSettings();
+    std::ostringstream out;
+    reader.HandleStatRequest(out);
+    return out.str();
+}
+
+json::Node Process(const std::string& input) {
+    std::istringstream answer(ProcessToText(input, false));
+    return json::Load(answer).GetRoot();
+}
+
+// Линия A - B - C и остановка D без автобусов. Ожидание 6 минут, 40 км/ч - 2000/3 м в минуту
+std::string MakeInput(const std::string& engine, const std::string& stat_requests) {
+    return R"({
+        "base_requests": [
+            {"type": "Stop", "name": "A", "latitude": 55.60, "longitude": 37.60, "road_distances": {"B": 1000}},
+            {"type": "Stop", "name": "B", "latitude": 55.61, "longitude": 37.60, "road_distances": {"C": 2000}},
+            {"type": "Stop", "name": "C", "latitude": 55.62, "longitude": 37.60, "road_distances": {}},
+            {"type": "Stop", "name": "D", "latitude": 55.63, "longitude": 37.60, "road_distances": {}},
+            {"type": "Bus", "name": "1", "stops": ["A", "B", "C"], "is_roundtrip": false}
+        ],
+        "routing_settings": {"bus_wait_time": 6, "bus_velocity": 40, "router_engine": ")" + engine + R"("},
+        "render_settings": {
+            "width": 600, "height": 400, "padding": 50, "line_width": 14, "stop_radius": 5,
+            "bus_label_font_size": 20, "bus_label_offset": [7, 15], "stop_label_font_size": 20,
+            "stop_label_offset": [7, -3], "underlayer_color": [255, 255, 255, 0.85], "underlayer_width": 3,
+            "color_palette": ["green", [255, 160, 0], "red"]
+        },
+        "stat_requests": )" + stat_requests + "}";
+}
+
+// Дополнительные профили маршрутизации в routing_settings входа MakeInput
+std::string WithProfiles(std::string input, const std::string& profiles) {
+    const std::string key = R"("router_engine")";
+    input.insert(input.find(key), R"("profiles": )" + profiles + ", ");
+    return input;
+}
+
+// Строка матрицы на каждую остановку отправления, столбец - на каждую назначения, недостижимые - null
+TEST(JsonReaderTest, MatrixHasRowPerSourceAndNullForUnreachable) {
+    const std::string requests = R"([{"id": 1, "type": "Matrix", "from": ["A", "D", "C"], "to": ["A", "C", "D"]}])";
+    for (const char* engine : {"all_pairs", "dijkstra", "source_cached", "contraction_hierarchy", "hub_labels", "raptor"}) {
+        const json::Array answers = Process(MakeInput(engine, requests)).AsArray();
+        ASSERT_EQ(answers.size(), 1u) << engine;
+        const json::Dict& answer = answers[0].AsDict();
+        EXPECT_EQ(answer.at("request_id").AsInt(), 1) << engine;
+        const json::Array& rows = answer.at("total_times").AsArray();
+        ASSERT_EQ(rows.size(), 3u) << engine;
+        for (const json::Node& row : rows) {
+            ASSERT_EQ(row.AsArray().size(), 3u) << engine;
+        }
+
+        const json::Array& from_a = rows[0].AsArray();
+        EXPECT_DOUBLE_EQ(from_a[0].AsDouble(), 0) << engine;
+        EXPECT_NEAR(from_a[1].AsDouble(), 10.5, 1e-6) << engine;
+        EXPECT_TRUE(from_a[2].IsNull()) << engine;
+        const json::Array& from_d = rows[1].AsArray();
+        EXPECT_TRUE(from_d[0].IsNull()) << engine;
+        EXPECT_TRUE(from_d[1].IsNull()) << engine;
+        EXPECT_DOUBLE_EQ(from_d[2].AsDouble(), 0) << engine;
+        // Линия некольцевая, поэтому из C можно уехать обратно в A
+        const json::Array& from_c = rows[2].AsArray();
+        EXPECT_NEAR(from_c[0].AsDouble(), 10.5, 1e-6) << engine;
+        EXPECT_DOUBLE_EQ(from_c[1].AsDouble(), 0) << engine;
+        EXPECT_TRUE(from_c[2].IsNull()) << engine;
+    }
+}
+
+// Неизвестная остановка в любом из списков - ошибка на весь запрос, соседние запросы не затронуты
+TEST(JsonReaderTest, MatrixWithUnknownStopIsNotFound) {
+    const std::string requests = R"([
+        {"id": 1, "type": "Matrix", "from": ["A", "Nowhere"], "to": ["C"]},
+        {"id": 2, "type": "Matrix", "from": ["A"], "to": ["Nowhere"]},
+        {"id": 3, "type": "Matrix", "from": ["A"], "to": ["B"]}
+    ])";
+    const json::Array answers = Process(MakeInput("dijkstra", requests)).AsArray();
+    ASSERT_EQ(answers.size(), 3u);
+    for (int i = 0; i < 2; ++i) {
+        const json::Dict& answer = answers[i].AsDict();
+        EXPECT_EQ(answer.at("request_id").AsInt(), i + 1);
+        EXPECT_EQ(answer.at("error_message").AsString(), "not found");
+        EXPECT_EQ(answer.count("total_times"), 0u);
+    }
+    const json::Dict& answer = answers[2].AsDict();
+    EXPECT_NEAR(answer.at("total_times").AsArray()[0].AsArray()[0].AsDouble(), 7.5, 1e-6);
+}
+
+// Профиль из ключа profile запроса меняет ответ: медленный едет A - C 3000 м со скоростью 20 км/ч
+// за 9 минут, терпеливый ждет 12 минут. Неизвестный профиль - not found
+TEST(JsonReaderTest, RouteProfilesGiveDifferentAnswers) {
+    const std::string requests = R"([
+        {"id": 1, "type": "Route", "from": "A", "to": "C"},
+        {"id": 2, "type": "Route", "from": "A", "to": "C", "profile": "slow"},
+        {"id": 3, "type": "Route", "from": "A", "to": "C", "profile": "patient"},
+        {"id": 4, "type": "Route", "from": "A", "to": "C", "profile": "fast"},
+        {"id": 5, "type": "Matrix", "from": ["A"], "to": ["C"], "profile": "slow"}
+    ])";
+    const std::string profiles = R"([{"name": "slow", "bus_velocity": 20}, {"name": "patient", "bus_wait_time": 12}])";
+    for (const char* engine : {"all_pairs", "dijkstra", "source_cached", "contraction_hierarchy", "hub_labels", "raptor"}) {
+        const json::Array answers = Process(WithProfiles(MakeInput(engine, requests), profiles)).AsArray();
+        ASSERT_EQ(answers.size(), 5u) << engine;
+        EXPECT_NEAR(answers[0].AsDict().at("total_time").AsDouble(), 10.5, 1e-3) << engine;
+        EXPECT_NEAR(answers[1].AsDict().at("total_time").AsDouble(), 15, 1e-3) << engine;
+        EXPECT_NEAR(answers[2].AsDict().at("total_time").AsDouble(), 16.5, 1e-3) << engine;
+        const json::Array& items = answers[2].AsDict().at("items").AsArray();
+        ASSERT_EQ(items.size(), 2u) << engine;
+        EXPECT_NEAR(items[0].AsDict().at("time").AsDouble(), 12, 1e-3) << engine;
+        EXPECT_EQ(answers[3].AsDict().at("error_message").AsString(), "not found") << engine;
+        EXPECT_NEAR(answers[4].AsDict().at("total_times").AsArray()[0].AsArray()[0].AsDouble(), 15, 1e-3) << engine;
+    }
+}
+
+// Повторное имя профиля отвергается, как и пустое - имя основного профиля
+TEST(JsonReaderTest, DuplicateProfileNameIsRejected) {
+    const std::string requests = R"([{"id": 1, "type": "Route", "from": "A", "to": "C"}])";
+    for (const char* profiles : {R"([{"name": "slow", "bus_velocity": 20}, {"name": "slow", "bus_wait_time": 12}])",
+                                 R"([{"name": "", "bus_velocity": 20}])"}) {
+        EXPECT_THROW(Process(WithProfiles(MakeInput("dijkstra", requests), profiles)), std::invalid_argument) << profiles;
+    }
+}
+
+// Остановка в update_requests меняет расстояние A - B: время маршрута и длина автобуса считаются по новому,
+// новая остановка добавляется в справочник
+TEST(JsonReaderTest, StopUpdateChangesDistances) {
+    const std::string requests = R"([
+        {"id": 1, "type": "Route", "from": "A", "to": "C"},
+        {"id": 2, "type": "Bus", "name": "1"},
+        {"id": 3, "type": "Stop", "name": "E"}
+    ])";
+    for (const char* engine : {"all_pairs", "dijkstra", "raptor"}) {
+        std::string input = MakeInput(engine, requests);
+        input.insert(input.size() - 1, R"(, "update_requests": [
+            {"type": "Stop", "name": "A", "road_distances": {"B": 4000}},
+            {"type": "Stop", "name": "E", "latitude": 55.64, "longitude": 37.60, "road_distances": {"D": 100}}
+        ])");
+        const json::Array answers = Process(input).AsArray();
+        ASSERT_EQ(answers.size(), 3u) << engine;
+        EXPECT_NEAR(answers[0].AsDict().at("total_time").AsDouble(), 15, 1e-3) << engine;
+        // Обратно B - A расстояние задано только новым A - B: 4000 + 2000 в обе стороны
+        EXPECT_EQ(answers[1].AsDict().at("route_length").AsInt(), 12000) << engine;
+        EXPECT_TRUE(answers[2].AsDict().at("buses").AsArray().empty()) << engine;
+    }
+}
+
+// Запрос неизвестного типа пропускается: в ответе нет ни его, ни null на его месте
+TEST(JsonReaderTest, UnknownRequestTypeIsSkipped) {
+    const std::string requests = R"([
+        {"id": 1, "type": "Stop", "name": "B"},
+        {"id": 2, "type": "Weather"},
+        {"id": 3, "type": "Route", "from": "A", "to": "C"}
+    ])";
+    for (const bool background : {false, true}) {
+        std::istringstream in(ProcessToText(MakeInput("dijkstra", requests), background));
+        const json::Array answers = json::Load(in).GetRoot().AsArray();
+        ASSERT_EQ(answers.size(), 2u) << background;
+        EXPECT_EQ(answers[0].AsDict().at("request_id").AsInt(), 1) << background;
+        EXPECT_EQ(answers[1].AsDict().at("request_id").AsInt(), 3) << background;
+    }
+}
+
+// С фоновым построением роутера ответы на Stop, Bus и Map уходят раньше маршрутных, но печатаются
+// в порядке запросов и совпадают с последовательной обработкой символ в символ
+TEST(JsonReaderTest, BackgroundRouterBuildKeepsAnswers) {
+    const std::string requests = R"([
+        {"id": 1, "type": "Route", "from": "A", "to": "C"},
+        {"id": 2, "type": "Stop", "name": "B"},
+        {"id": 3, "type": "Bus", "name": "1"},
+        {"id": 4, "type": "Route", "from": "C", "to": "D"},
+        {"id": 5, "type": "Map"},
+        {"id": 6, "type": "Matrix", "from": ["A"], "to": ["B", "C"]},
+        {"id": 7, "type": "Stop", "name": "Nowhere"},
+        {"id": 8, "type": "Reachable", "from": "A", "max_time": 8},
+        {"id": 9, "type": "Bus", "name": "2"},
+        {"id": 10, "type": "Route", "from": "B", "to": "A"}
+    ])";
+    for (const char* engine : {"all_pairs", "dijkstra", "raptor"}) {
+        const std::string input = MakeInput(engine, requests);
+        const std::string sequential = ProcessToText(input, false);
+        EXPECT_EQ(ProcessToText(input, true), sequential) << engine;
+
+        std::istringstream in(sequential);
+        const json::Array answers = json::Load(in).GetRoot().AsArray();
+        ASSERT_EQ(answers.size(), 10u) << engine;
+        for (size_t i = 0; i < answers.size(); ++i) {
+            EXPECT_EQ(answers[i].AsDict().at("request_id").AsInt(), static_cast<int>(i + 1)) << engine;
+        }
+        EXPECT_NEAR(answers[0].AsDict().at("total_time").AsDouble(), 10.5, 1e-6) << engine;
+        EXPECT_EQ(answers[3].AsDict().at("error_message").AsString(), "not found") << engine;
+        EXPECT_EQ(answers[4].AsDict().count("map"), 1u) << engine;
+    }
+}
+
+}  // namespace
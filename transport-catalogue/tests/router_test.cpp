@@ -0,0 +1,397 @@
+#include "contraction_hierarchy.h"
+#include "dijkstra_router.h"
+#include "hub_label_router.h"
+#include "source_cached_router.h"
+#include "relax_kernel.h"
+#include "router.h"
+#include "synthetic_graph.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using Graph = graph::DirectedWeightedGraph<int64_t>;
+
+// Путь маршрута идет из from в to по ребрам графа, и его вес - сумма их весов
+void ExpectValidRoute(const Graph& graph, graph::VertexId from, graph::VertexId to,
+                      const graph::Router<int64_t>::RouteInfo& route) {
+    graph::VertexId vertex = from;
+    int64_t weight = 0;
+    for (const graph::EdgeId edge_id : route.edges) {
+        const auto& edge = graph.GetEdge(edge_id);
+        ASSERT_EQ(edge.from, vertex);
+        vertex = edge.to;
+        weight += edge.weight;
+    }
+    EXPECT_EQ(vertex, to);
+    EXPECT_EQ(weight, route.weight);
+}
+
+// Целые веса таблица хранит без округления: вес каждого маршрута равен точному кратчайшему.
+// Веса около 2^40 различаются в младших битах, которые не помещаются в мантиссу float
+TEST(RouterTest, AllPairsWeightsAreExactShortestPaths) {
+    for (const uint32_t seed : {1u, 2u, 3u}) {
+        synthetic::GraphOptions options;
+        options.vertex_count = 120;
+        options.edge_count = 500;
+        options.max_weight = 1000;
+        options.weight_offset = int64_t{1} << 40;
+        options.seed = seed;
+        const Graph graph = synthetic::MakeRandomGraph(options);
+        const graph::Router<int64_t> router(graph);
+        const graph::DijkstraRouter<int64_t> dijkstra(graph);
+
+        for (graph::VertexId from = 0; from < options.vertex_count; ++from) {
+            for (graph::VertexId to = 0; to < options.vertex_count; ++to) {
+                const auto route = router.BuildRoute(from, to);
+                const auto expected = dijkstra.BuildRoute(from, to);
+                ASSERT_EQ(route.has_value(), expected.has_value()) << from << " -> " << to;
+                if (route) {
+                    ASSERT_EQ(route->weight, expected->weight) << from << " -> " << to;
+                    ExpectValidRoute(router.GetGraph(), from, to, *route);
+                }
+            }
+        }
+    }
+}
+
+// Последовательный Флойд-Уоршелл по полной таблице с тем же правилом равенства: из равных
+// путей остается путь с меньшим последним ребром
+std::vector<std::vector<graph::EdgeId>> BuildSerialRoutes(const Graph& graph) {
+    constexpr int64_t infinity = std::numeric_limits<int64_t>::max();
+    constexpr uint32_t no_edge = std::numeric_limits<uint32_t>::max();
+    const size_t vertex_count = graph.GetVertexCount();
+    std::vector<std::vector<int64_t>> weights(vertex_count, std::vector<int64_t>(vertex_count, infinity));
+    std::vector<std::vector<uint32_t>> prev_edges(vertex_count, std::vector<uint32_t>(vertex_count, no_edge));
+    for (graph::VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        weights[vertex][vertex] = 0;
+    }
+    for (graph::EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+        const auto& edge = graph.GetEdge(edge_id);
+        if (edge.weight < weights[edge.from][edge.to]) {
+            weights[edge.from][edge.to] = edge.weight;
+            prev_edges[edge.from][edge.to] = static_cast<uint32_t>(edge_id);
+        }
+    }
+    for (size_t through = 0; through < vertex_count; ++through) {
+        for (size_t from = 0; from < vertex_count; ++from) {
+            if (weights[from][through] == infinity) {
+                continue;
+            }
+            for (size_t to = 0; to < vertex_count; ++to) {
+                if (weights[through][to] == infinity) {
+                    continue;
+                }
+                const int64_t candidate = weights[from][through] + weights[through][to];
+                if (candidate < weights[from][to]
+                    || (candidate == weights[from][to] && prev_edges[through][to] < prev_edges[from][to])) {
+                    weights[from][to] = candidate;
+                    prev_edges[from][to] = prev_edges[through][to];
+                }
+            }
+        }
+    }
+
+    std::vector<std::vector<graph::EdgeId>> routes(vertex_count * vertex_count);
+    for (graph::VertexId from = 0; from < vertex_count; ++from) {
+        for (graph::VertexId to = 0; to < vertex_count; ++to) {
+            auto& route = routes[from * vertex_count + to];
+            for (uint32_t edge_id = prev_edges[from][to]; edge_id != no_edge;
+                 edge_id = prev_edges[from][graph.GetEdge(edge_id).from]) {
+                route.insert(route.begin(), edge_id);
+            }
+        }
+    }
+    return routes;
+}
+
+// Малые веса дают много равных путей. Блочная таблица с любым числом потоков выбирает те же
+// ребра, что и последовательная: больше 64 вершин, чтобы блоков было несколько
+TEST(RouterTest, BlockedTableMatchesSerialOnTies) {
+    for (const uint32_t seed : {1u, 2u, 3u, 4u}) {
+        synthetic::GraphOptions options;
+        options.vertex_count = 150;
+        options.edge_count = 600;
+        options.max_weight = 3;
+        options.seed = seed;
+        const Graph graph = synthetic::MakeRandomGraph(options);
+        const auto expected = BuildSerialRoutes(graph);
+
+        for (const size_t thread_count : {1u, 3u, 8u}) {
+            const graph::Router<int64_t> router(graph, thread_count);
+            for (graph::VertexId from = 0; from < options.vertex_count; ++from) {
+                for (graph::VertexId to = 0; to < options.vertex_count; ++to) {
+                    const auto route = router.BuildRoute(from, to);
+                    const auto& expected_edges = expected[from * options.vertex_count + to];
+                    if (!route) {
+                        ASSERT_TRUE(expected_edges.empty() && from != to) << from << " -> " << to;
+                        continue;
+                    }
+                    ASSERT_EQ(route->edges, expected_edges)
+                        << "seed " << seed << ", threads " << thread_count << ": " << from << " -> " << to;
+                }
+            }
+        }
+    }
+}
+
+// Из равных путей Дейкстра и иерархия сжатия выбирают тот же путь, что и таблица всех пар
+TEST(RouterTest, EnginesChooseTheSameRouteOnTies) {
+    for (const uint32_t seed : {1u, 2u, 3u, 4u, 5u}) {
+        synthetic::GraphOptions options;
+        options.vertex_count = 150;
+        options.edge_count = 600;
+        options.max_weight = 3;
+        options.seed = seed;
+        const Graph graph = synthetic::MakeRandomGraph(options);
+        const graph::Router<int64_t> router(graph);
+        const graph::DijkstraRouter<int64_t> dijkstra(graph);
+        const graph::ContractionHierarchy<int64_t> hierarchy(graph);
+
+        for (graph::VertexId from = 0; from < options.vertex_count; ++from) {
+            for (graph::VertexId to = 0; to < options.vertex_count; ++to) {
+                const auto expected = router.BuildRoute(from, to);
+                const auto dijkstra_route = dijkstra.BuildRoute(from, to);
+                const auto hierarchy_route = hierarchy.BuildRoute(from, to);
+                ASSERT_EQ(dijkstra_route.has_value(), expected.has_value()) << from << " -> " << to;
+                ASSERT_EQ(hierarchy_route.has_value(), expected.has_value()) << from << " -> " << to;
+                if (expected) {
+                    ASSERT_EQ(dijkstra_route->edges, expected->edges) << "seed " << seed << ": " << from << " -> " << to;
+                    ASSERT_EQ(hierarchy_route->edges, expected->edges) << "seed " << seed << ": " << from << " -> " << to;
+                    EXPECT_EQ(hierarchy_route->weight, expected->weight);
+                }
+            }
+        }
+    }
+}
+
+// Метки хабов дают те же веса и те же ребра, что и Дейкстра, в том числе на равных путях
+TEST(RouterTest, HubLabelsMatchDijkstra) {
+    for (const uint32_t seed : {1u, 2u, 3u}) {
+        synthetic::GraphOptions options;
+        options.vertex_count = 150;
+        options.edge_count = 600;
+        options.max_weight = 3;
+        options.seed = seed;
+        const Graph graph = synthetic::MakeRandomGraph(options);
+        const graph::DijkstraRouter<int64_t> dijkstra(graph);
+        const graph::HubLabelRouter<int64_t> labels(graph);
+
+        for (graph::VertexId from = 0; from < options.vertex_count; ++from) {
+            for (graph::VertexId to = 0; to < options.vertex_count; ++to) {
+                const auto expected = dijkstra.BuildRoute(from, to);
+                const auto route = labels.BuildRoute(from, to);
+                ASSERT_EQ(route.has_value(), expected.has_value()) << from << " -> " << to;
+                if (expected) {
+                    ASSERT_EQ(route->weight, expected->weight) << "seed " << seed << ": " << from << " -> " << to;
+                    ASSERT_EQ(route->edges, expected->edges) << "seed " << seed << ": " << from << " -> " << to;
+                }
+            }
+        }
+    }
+}
+
+// Пачки хабов и их порядок не зависят от числа потоков, поэтому метки совпадают запись в запись
+TEST(RouterTest, HubLabelsDoNotDependOnThreadCount) {
+    synthetic::GraphOptions options;
+    options.vertex_count = 400;
+    options.edge_count = 1600;
+    options.max_weight = 5;
+    const Graph graph = synthetic::MakeRandomGraph(options);
+    const graph::HubLabelRouter<int64_t> serial(graph, 1);
+    const graph::HubLabelRouter<int64_t> parallel(graph, 4);
+
+    const auto expect_equal = [](auto lhs, auto rhs, graph::VertexId vertex) {
+        ASSERT_EQ(lhs.end() - lhs.begin(), rhs.end() - rhs.begin()) << vertex;
+        for (auto lhs_it = lhs.begin(), rhs_it = rhs.begin(); lhs_it != lhs.end(); ++lhs_it, ++rhs_it) {
+            EXPECT_EQ(lhs_it->hub, rhs_it->hub) << vertex;
+            EXPECT_EQ(lhs_it->parent_edge, rhs_it->parent_edge) << vertex;
+            EXPECT_EQ(lhs_it->weight, rhs_it->weight) << vertex;
+        }
+    };
+    EXPECT_EQ(serial.GetLabelCount(), parallel.GetLabelCount());
+    for (graph::VertexId vertex = 0; vertex < options.vertex_count; ++vertex) {
+        expect_equal(serial.GetInLabel(vertex), parallel.GetInLabel(vertex), vertex);
+        expect_equal(serial.GetOutLabel(vertex), parallel.GetOutLabel(vertex), vertex);
+    }
+}
+
+// Бюджет на два дерева: третье вытесняет дольше всех не использованное, попадание делает дерево свежим
+TEST(RouterTest, SourceCacheEvictsLeastRecentlyUsedTree) {
+    synthetic::GraphOptions options;
+    const Graph graph = synthetic::MakeRandomGraph(options);
+    const size_t tree_bytes = graph::ShortestPathTree<int64_t>::EstimateMemory(options.vertex_count);
+    const graph::SourceCachedRouter<int64_t> router(graph, 2 * tree_bytes);
+    const graph::DijkstraRouter<int64_t> dijkstra(graph);
+
+    for (const graph::VertexId from : {0, 0, 1, 2, 1, 0}) {
+        const auto route = router.BuildRoute(from, 5);
+        const auto expected = dijkstra.BuildRoute(from, 5);
+        ASSERT_EQ(route.has_value(), expected.has_value());
+        if (expected) {
+            EXPECT_EQ(route->edges, expected->edges);
+            EXPECT_EQ(route->weight, expected->weight);
+        }
+    }
+    // 0 - промах, 0 - попадание, 1 и 2 - промахи, 2 вытесняет 0, 1 - попадание, 0 - промах, вытесняет 2
+    const graph::SourceCacheStats stats = router.GetCacheStats();
+    EXPECT_EQ(stats.hits, 2u);
+    EXPECT_EQ(stats.misses, 4u);
+    EXPECT_EQ(stats.evictions, 2u);
+    EXPECT_EQ(stats.tree_count, 2u);
+    EXPECT_EQ(stats.bytes, 2 * tree_bytes);
+}
+
+// Дерево больше бюджета строится на каждый запрос и в кэш не попадает
+TEST(RouterTest, SourceCacheSkipsTreesAboveBudget) {
+    synthetic::GraphOptions options;
+    const Graph graph = synthetic::MakeRandomGraph(options);
+    const size_t tree_bytes = graph::ShortestPathTree<int64_t>::EstimateMemory(options.vertex_count);
+    const graph::SourceCachedRouter<int64_t> router(graph, tree_bytes - 1);
+
+    for (int i = 0; i < 3; ++i) {
+        router.BuildRoute(0, 5);
+    }
+    const graph::SourceCacheStats stats = router.GetCacheStats();
+    EXPECT_EQ(stats.hits, 0u);
+    EXPECT_EQ(stats.misses, 3u);
+    EXPECT_EQ(stats.evictions, 0u);
+    EXPECT_EQ(stats.tree_count, 0u);
+    EXPECT_EQ(stats.bytes, 0u);
+}
+
+// Ребра, дописанные в замороженный граф, раскладываются по строкам так же, как при сборке из всего списка
+TEST(RouterTest, AppendedEdgesMatchFullBuild) {
+    synthetic::GraphOptions options;
+    options.vertex_count = 200;
+    options.edge_count = 1000;
+    const Graph full = synthetic::MakeRandomGraph(options);
+
+    std::vector<graph::Edge<int64_t>> edges;
+    for (graph::EdgeId edge_id = 0; edge_id < full.GetEdgeCount(); ++edge_id) {
+        edges.push_back(full.GetEdge(edge_id));
+    }
+    Graph graph(options.vertex_count, std::vector<graph::Edge<int64_t>>(edges.begin(), edges.begin() + 600));
+    for (const auto& [begin, end] : {std::pair<size_t, size_t>{600, 601}, {601, 800}, {800, 1000}}) {
+        EXPECT_EQ(graph.AppendEdges(std::vector<graph::Edge<int64_t>>(edges.begin() + begin, edges.begin() + end)), begin);
+    }
+
+    ASSERT_EQ(graph.GetEdgeCount(), full.GetEdgeCount());
+    for (graph::VertexId vertex = 0; vertex < options.vertex_count; ++vertex) {
+        const auto expected = full.GetIncidentEdges(vertex);
+        const auto incident = graph.GetIncidentEdges(vertex);
+        ASSERT_EQ(std::vector<graph::EdgeId>(incident.begin(), incident.end()),
+                  std::vector<graph::EdgeId>(expected.begin(), expected.end())) << vertex;
+        const auto expected_arcs = full.GetIncidentArcs(vertex);
+        auto arc = graph.GetIncidentArcs(vertex).begin();
+        for (const auto& expected_arc : expected_arcs) {
+            EXPECT_EQ((*arc).to, expected_arc.to) << vertex;
+            EXPECT_EQ((*arc).weight, expected_arc.weight) << vertex;
+            ++arc;
+        }
+    }
+    for (graph::EdgeId edge_id = 0; edge_id < full.GetEdgeCount(); ++edge_id) {
+        EXPECT_EQ(graph.GetEdge(edge_id).from, edges[edge_id].from) << edge_id;
+        EXPECT_EQ(graph.GetEdge(edge_id).to, edges[edge_id].to) << edge_id;
+        EXPECT_EQ(graph.GetEdge(edge_id).weight, edges[edge_id].weight) << edge_id;
+    }
+
+    // Ребро с концом или началом вне графа не добавляется, и граф остается прежним
+    const graph::VertexId outside = options.vertex_count;
+    Graph lists(options.vertex_count);
+    for (Graph* target : {&graph, &lists}) {
+        EXPECT_THROW(target->AppendEdges({{0, 1, 5}, {0, outside, 5}}), std::out_of_range);
+        EXPECT_THROW(target->AppendEdges({{outside, 0, 5}}), std::out_of_range);
+    }
+    EXPECT_EQ(lists.GetEdgeCount(), 0u);
+    EXPECT_EQ(graph.GetEdgeCount(), full.GetEdgeCount());
+    EXPECT_EQ(graph.GetIncidentEdges(0).end() - graph.GetIncidentEdges(0).begin(),
+              full.GetIncidentEdges(0).end() - full.GetIncidentEdges(0).begin());
+}
+
+// Таблица, дополненная ребрами, совпадает с построенной заново по всему графу, вплоть до выбора из равных путей
+TEST(RouterTest, AddEdgesMatchesRebuild) {
+    for (const uint32_t seed : {1u, 2u, 3u}) {
+        synthetic::GraphOptions options;
+        options.vertex_count = 150;
+        options.edge_count = 600;
+        options.max_weight = 3;
+        options.seed = seed;
+        const Graph full = synthetic::MakeRandomGraph(options);
+        std::vector<graph::Edge<int64_t>> edges;
+        for (graph::EdgeId edge_id = 0; edge_id < full.GetEdgeCount(); ++edge_id) {
+            edges.push_back(full.GetEdge(edge_id));
+        }
+
+        graph::Router<int64_t> router(Graph(options.vertex_count, std::vector<graph::Edge<int64_t>>(edges.begin(), edges.begin() + 450)));
+        router.AddEdges(std::vector<graph::Edge<int64_t>>(edges.begin() + 450, edges.begin() + 500));
+        router.AddEdges(std::vector<graph::Edge<int64_t>>(edges.begin() + 500, edges.end()), 3);
+        const graph::Router<int64_t> rebuilt(full);
+
+        for (graph::VertexId from = 0; from < options.vertex_count; ++from) {
+            for (graph::VertexId to = 0; to < options.vertex_count; ++to) {
+                const auto route = router.BuildRoute(from, to);
+                const auto expected = rebuilt.BuildRoute(from, to);
+                ASSERT_EQ(route.has_value(), expected.has_value()) << from << " -> " << to;
+                if (expected) {
+                    ASSERT_EQ(route->weight, expected->weight) << "seed " << seed << ": " << from << " -> " << to;
+                    ASSERT_EQ(route->edges, expected->edges) << "seed " << seed << ": " << from << " -> " << to;
+                }
+            }
+        }
+    }
+}
+
+// Каждая реализация RelaxRow, которую может исполнить процессор, а не только выбранная, совпадает
+// со скалярной. В строках много равных весов, недостижимых ячеек и номеров ребер по обе стороны 2^31,
+// длины строк дают все остатки от деления на ширину вектора
+TEST(RouterTest, RelaxRowKernelsMatchScalar) {
+    constexpr int64_t infinity = std::numeric_limits<int64_t>::max();
+    const std::vector<uint32_t> edge_samples{0, 1, 2, 0x7fffffffu, 0x80000000u, 0x80000001u, 0xfffffffeu, 0xffffffffu};
+    const std::vector<graph::details::RelaxRowKernel> kernels = graph::details::GetSupportedRelaxRowKernels();
+    ASSERT_EQ(std::string(kernels.front().name), "scalar");
+
+    synthetic::Random random(7);
+    const auto random_weight = [&random](int64_t max_weight) {
+        return random.Below(5) == 0 ? infinity : static_cast<int64_t>(random.Below(static_cast<size_t>(max_weight)));
+    };
+    const auto random_edge = [&random, &edge_samples]() {
+        return random.Below(2) == 0 ? edge_samples[random.Below(edge_samples.size())] : random.Next();
+    };
+    for (int row = 0; row < 2000; ++row) {
+        const size_t count = random.Below(42);
+        const int64_t from_weight = static_cast<int64_t>(random.Below(20));
+        std::vector<int64_t> through_weights(count);
+        std::vector<uint32_t> through_prev_edges(count);
+        std::vector<int64_t> weights(count);
+        std::vector<uint32_t> prev_edges(count);
+        for (size_t i = 0; i < count; ++i) {
+            through_weights[i] = random_weight(20);
+            through_prev_edges[i] = random_edge();
+            weights[i] = random_weight(40);
+            prev_edges[i] = random_edge();
+        }
+
+        std::vector<int64_t> expected_weights = weights;
+        std::vector<uint32_t> expected_prev_edges = prev_edges;
+        kernels.front().function(from_weight, through_weights.data(), through_prev_edges.data(),
+                                 expected_weights.data(), expected_prev_edges.data(), count);
+        for (const auto& kernel : kernels) {
+            std::vector<int64_t> kernel_weights = weights;
+            std::vector<uint32_t> kernel_prev_edges = prev_edges;
+            kernel.function(from_weight, through_weights.data(), through_prev_edges.data(),
+                            kernel_weights.data(), kernel_prev_edges.data(), count);
+            ASSERT_EQ(kernel_weights, expected_weights) << kernel.name << " row " << row;
+            ASSERT_EQ(kernel_prev_edges, expected_prev_edges) << kernel.name << " row " << row;
+        }
+    }
+}
+
+}  // namespace
@@ -0,0 +1,178 @@
+#include "synthetic_network.h"
+#include "transport_catalogue.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+namespace {
+
+using transport_catalogue::TransportCatalogue;
+
+TEST(TransportCatalogueTest, FindStopIndexReturnsInsertionOrder) {
+    TransportCatalogue catalogue;
+    catalogue.AddStop("A", {55.0, 37.0});
+    catalogue.AddStop("B", {55.1, 37.1});
+    catalogue.AddStop("C", {55.2, 37.2});
+
+    EXPECT_EQ(catalogue.FindStopIndex("A"), 0);
+    EXPECT_EQ(catalogue.FindStopIndex("B"), 1);
+    EXPECT_EQ(catalogue.FindStopIndex("C"), 2);
+    EXPECT_EQ(catalogue.FindStopIndex("D"), std::nullopt);
+    EXPECT_EQ(catalogue.FindStop("B")->id, 1u);
+}
+
+TEST(TransportCatalogueTest, FindStopIndexMatchesStopIdsOnSyntheticNetwork) {
+    TransportCatalogue catalogue;
+    synthetic::NetworkOptions options;
+    options.stop_count = 500;
+    options.bus_count = 40;
+    synthetic::FillCatalogue(catalogue, options);
+
+    ASSERT_EQ(catalogue.GetStopsCount(), options.stop_count);
+    for (size_t stop = 0; stop < options.stop_count; ++stop) {
+        const std::string name = synthetic::StopName(stop);
+        ASSERT_EQ(catalogue.FindStopIndex(name), static_cast<int>(stop));
+        EXPECT_EQ(catalogue.GetStop(static_cast<StopId>(stop)).name, name);
+    }
+}
+
+TEST(TransportCatalogueTest, EmptyBusHasZeroInfo) {
+    TransportCatalogue catalogue;
+    catalogue.AddStop("A", {55.0, 37.0});
+    catalogue.AddStop("B", {55.01, 37.0});
+    catalogue.AddDistance("A", "B", 1000);
+    catalogue.AddBus("Empty", {}, false);
+    catalogue.AddBus("EmptyRound", {}, true);
+    catalogue.AddBus("AB", {"A", "B"}, false);
+
+    // Без Finalize сведения считаются на копии автобуса, после - берутся из готовых
+    for (const bool finalized : {false, true}) {
+        if (finalized) {
+            catalogue.Finalize();
+        }
+        for (const char* name : {"Empty", "EmptyRound"}) {
+            const BusInfo info = catalogue.GetInfo(catalogue.FindBus(name));
+            EXPECT_EQ(info.stops_route, 0) << name;
+            EXPECT_EQ(info.unique_stops, 0) << name;
+            EXPECT_EQ(info.length, 0) << name;
+            EXPECT_EQ(info.curvature, 0.0) << name;
+        }
+        const BusInfo info = catalogue.GetInfo(catalogue.FindBus("AB"));
+        EXPECT_EQ(info.stops_route, 3);
+        EXPECT_EQ(info.length, 2000);
+    }
+}
+
+// После Finalize сведения досчитываются только для нового автобуса и совпадают с полным Finalize
+TEST(TransportCatalogueTest, FinalizeNewBusesComputesOnlyNewBuses) {
+    TransportCatalogue catalogue;
+    synthetic::NetworkOptions options;
+    options.stop_count = 500;
+    options.bus_count = 40;
+    synthetic::FillCatalogue(catalogue, options);
+
+    const std::vector<std::string> names{synthetic::StopName(3), synthetic::StopName(4), synthetic::StopName(5)};
+    catalogue.AddBus("New", {names[0], names[1], names[2]}, false);
+    catalogue.FinalizeNewBuses();
+    EXPECT_TRUE(catalogue.IsFinalized());
+    EXPECT_EQ(catalogue.GetFinalizeStats().buses_count, 1u);
+
+    TransportCatalogue rebuilt = catalogue;
+    rebuilt.Finalize();
+    for (size_t bus = 0; bus <= options.bus_count; ++bus) {
+        const std::string name = bus < options.bus_count ? synthetic::BusName(bus) : "New";
+        const BusInfo info = catalogue.GetInfo(catalogue.FindBus(name));
+        const BusInfo expected = rebuilt.GetInfo(rebuilt.FindBus(name));
+        EXPECT_EQ(info.stops_route, expected.stops_route) << name;
+        EXPECT_EQ(info.unique_stops, expected.unique_stops) << name;
+        EXPECT_EQ(info.length, expected.length) << name;
+        EXPECT_DOUBLE_EQ(info.curvature, expected.curvature) << name;
+    }
+
+    // Новое расстояние может изменить длины прежних автобусов: досчет превращается в полный Finalize
+    catalogue.AddDistance(names[0], names[1], 12345);
+    catalogue.AddBus("Newer", {names[1], names[2]}, true);
+    catalogue.FinalizeNewBuses();
+    EXPECT_EQ(catalogue.GetFinalizeStats().buses_count, options.bus_count + 2);
+}
+
+// Обратное направление без своего расстояния берет прямое; заданные оба направления не смешиваются.
+// Результат одинаков в хеш-таблице и в замороженной CSR-таблице
+TEST(TransportCatalogueTest, FrozenDistancesKeepReverseFallback) {
+    TransportCatalogue catalogue;
+    catalogue.AddStop("A", {55.0, 37.0});
+    catalogue.AddStop("B", {55.01, 37.0});
+    catalogue.AddStop("C", {55.02, 37.0});
+    catalogue.AddDistance("A", "B", 1000);
+    catalogue.AddDistance("A", "C", 1500);
+    catalogue.AddDistance("C", "A", 2500);
+
+    for (const bool frozen : {false, true}) {
+        if (frozen) {
+            catalogue.FreezeDistances();
+        }
+        EXPECT_EQ(catalogue.FindDistance("A", "B"), 1000) << frozen;
+        EXPECT_EQ(catalogue.FindDistance("B", "A"), 1000) << frozen;
+        EXPECT_EQ(catalogue.FindDistance("A", "C"), 1500) << frozen;
+        EXPECT_EQ(catalogue.FindDistance("C", "A"), 2500) << frozen;
+        EXPECT_EQ(catalogue.FindDistance("B", "C"), 0) << frozen;
+    }
+}
+
+// AddDistance после заморозки размораживает таблицу: новое расстояние заменяет подставленное обратное
+// и заданное прежде, остальные переживают повторную заморозку
+TEST(TransportCatalogueTest, DistanceAddedAfterFreezeTakesEffect) {
+    TransportCatalogue catalogue;
+    catalogue.AddStop("A", {55.0, 37.0});
+    catalogue.AddStop("B", {55.01, 37.0});
+    catalogue.AddStop("C", {55.02, 37.0});
+    catalogue.AddDistance("A", "B", 1000);
+    catalogue.AddDistance("B", "C", 2000);
+    catalogue.AddBus("ABC", {"A", "B", "C"}, false);
+    catalogue.Finalize();
+    EXPECT_EQ(catalogue.GetInfo(catalogue.FindBus("ABC")).length, 6000);
+
+    catalogue.AddDistance("B", "A", 700);
+    catalogue.AddDistance("B", "C", 2200);
+    EXPECT_FALSE(catalogue.IsFinalized());
+    for (const bool frozen : {false, true}) {
+        if (frozen) {
+            catalogue.Finalize();
+            EXPECT_EQ(catalogue.GetInfo(catalogue.FindBus("ABC")).length, 1000 + 2200 + 2200 + 700);
+        }
+        EXPECT_EQ(catalogue.FindDistance("A", "B"), 1000) << frozen;
+        EXPECT_EQ(catalogue.FindDistance("B", "A"), 700) << frozen;
+        EXPECT_EQ(catalogue.FindDistance("B", "C"), 2200) << frozen;
+        EXPECT_EQ(catalogue.FindDistance("C", "B"), 2200) << frozen;
+    }
+}
+
+// Сведения автобусов не зависят от числа потоков Finalize: каждый автобус считается целиком одним потоком
+TEST(TransportCatalogueTest, FinalizeDoesNotDependOnThreadCount) {
+    synthetic::NetworkOptions options;
+    options.stop_count = 500;
+    options.bus_count = 60;
+    TransportCatalogue single;
+    synthetic::FillCatalogue(single, options);
+    single.Finalize(1);
+
+    for (const size_t thread_count : {2u, 7u, 64u}) {
+        TransportCatalogue parallel;
+        synthetic::FillCatalogue(parallel, options);
+        parallel.Finalize(thread_count);
+        EXPECT_EQ(parallel.GetFinalizeStats().thread_count, thread_count);
+        for (size_t bus = 0; bus < options.bus_count; ++bus) {
+            const std::string name = synthetic::BusName(bus);
+            const BusInfo info = parallel.GetInfo(parallel.FindBus(name));
+            const BusInfo expected = single.GetInfo(single.FindBus(name));
+            EXPECT_EQ(info.stops_route, expected.stops_route) << name << ' ' << thread_count;
+            EXPECT_EQ(info.unique_stops, expected.unique_stops) << name << ' ' << thread_count;
+            EXPECT_EQ(info.length, expected.length) << name << ' ' << thread_count;
+            EXPECT_EQ(info.curvature, expected.curvature) << name << ' ' << thread_count;
+        }
+    }
+}
+
+}  // namespace
@@ -0,0 +1,419 @@
+#include "synthetic_network.h"
+#include "transport_catalogue.h"
+#include "transport_router.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace {
+
+using transport_catalogue::TransportCatalogue;
+using transport_router::RouterEngine;
+using transport_router::RoutingSettings;
+using transport_router::TransportRouter;
+
+RoutingSettings MakeSettings(size_t expected_queries, size_t expected_sources) {
+    RoutingSettings settings;
+    settings.bus_wait_time = 6;
+    settings.bus_velocity = 40;
+    settings.expected_queries = expected_queries;
+    settings.expected_sources = expected_sources;
+    return settings;
+}
+
+void FillNetwork(TransportCatalogue& catalogue, size_t stop_count) {
+    synthetic::NetworkOptions options;
+    options.stop_count = stop_count;
+    options.bus_count = stop_count / 10;
+    options.stops_per_bus = 20;
+    synthetic::FillCatalogue(catalogue, options);
+}
+
+// Выбор AUTO по справочнику без построения графа, как в CreateGraph
+RouterEngine ChooseAutoEngine(const TransportCatalogue& catalogue, const RoutingSettings& settings) {
+    const auto estimates = transport_router::details::EstimateEngines(
+        catalogue.GetStopsCount() * 2, transport_router::details::CountGraphEdges(catalogue),
+        transport_router::RaptorRouter::CountLinePositions(catalogue), settings);
+    return transport_router::details::ChooseEngine(estimates, settings.memory_limit_bytes);
+}
+
+TEST(TransportRouterAutoTest, SmallNetworkWithFewQueriesUsesRaptor) {
+    TransportCatalogue catalogue;
+    FillNetwork(catalogue, 300);
+    TransportRouter router(catalogue);
+    router.SetRoutingSettings(MakeSettings(100, 100));
+    router.CreateGraph();
+
+    const transport_router::RouterStats stats = router.GetStats();
+    EXPECT_FALSE(stats.engine_forced);
+    EXPECT_EQ(stats.engine, RouterEngine::RAPTOR);
+}
+
+TEST(TransportRouterAutoTest, SmallNetworkWithManyQueriesUsesAllPairs) {
+    TransportCatalogue catalogue;
+    FillNetwork(catalogue, 300);
+    // Без кэша деревьев повторные источники ищутся заново, и таблица всех пар окупается
+    RoutingSettings settings = MakeSettings(1000000, 300);
+    settings.source_cache_bytes = 0;
+    TransportRouter router(catalogue);
+    router.SetRoutingSettings(settings);
+    router.CreateGraph();
+
+    const transport_router::RouterStats stats = router.GetStats();
+    EXPECT_EQ(stats.engine, RouterEngine::ALL_PAIRS);
+    EXPECT_EQ(stats.vertex_count, 600u);
+    EXPECT_EQ(ChooseAutoEngine(catalogue, settings), RouterEngine::ALL_PAIRS);
+}
+
+TEST(TransportRouterAutoTest, LargeNetworkAvoidsAllPairs) {
+    TransportCatalogue catalogue;
+    FillNetwork(catalogue, 50000);
+
+    // Таблица всех пар на 100 тысяч вершин не помещается в лимит по умолчанию
+    EXPECT_EQ(ChooseAutoEngine(catalogue, MakeSettings(100, 100)), RouterEngine::RAPTOR);
+    EXPECT_EQ(ChooseAutoEngine(catalogue, MakeSettings(1000000, 50000)), RouterEngine::HUB_LABELS);
+
+    // В мегабайт помещается только поиск Дейкстры без индекса
+    RoutingSettings settings = MakeSettings(1000000, 50000);
+    settings.memory_limit_bytes = size_t{1} << 20;
+    EXPECT_EQ(ChooseAutoEngine(catalogue, settings), RouterEngine::DIJKSTRA);
+}
+
+// Участки маршрута одной строкой, времена - без округления
+std::string DescribeRoute(const transport_router::RouteInfo& route) {
+    std::ostringstream out;
+    out << std::setprecision(17);
+    if (!route.total_time_) {
+        return "none";
+    }
+    out << *route.total_time_ << ':';
+    for (const auto& item : route.items_) {
+        if (const auto* wait = std::get_if<transport_router::WaitStopInfo>(&item)) {
+            out << " Wait " << wait->stop_name_ << ' ' << wait->time_ << ';';
+        } else {
+            const auto& bus = std::get<transport_router::WaitBusInfo>(item);
+            out << " Bus " << bus.bus_name_ << ' ' << bus.span_count_ << ' ' << bus.time_ << ';';
+        }
+    }
+    return out.str();
+}
+
+// Общие перегоны разных автобусов дают много маршрутов равного времени. RAPTOR выбирает из них
+// тот же, что и таблица всех пар: те же автобусы, число пролетов и остановки пересадок
+TEST(TransportRouterTest, RaptorChoosesTheSameRouteAsAllPairsOnTies) {
+    for (const uint32_t seed : {1u, 2u, 3u}) {
+        TransportCatalogue catalogue;
+        synthetic::NetworkOptions options;
+        options.stop_count = 60;
+        options.bus_count = 20;
+        options.stops_per_bus = 8;
+        options.seed = seed;
+        synthetic::FillCatalogue(catalogue, options);
+
+        RoutingSettings settings = MakeSettings(0, 0);
+        settings.engine = RouterEngine::ALL_PAIRS;
+        TransportRouter all_pairs(catalogue);
+        all_pairs.SetRoutingSettings(settings);
+        settings.engine = RouterEngine::RAPTOR;
+        TransportRouter raptor(catalogue);
+        raptor.SetRoutingSettings(settings);
+
+        size_t route_count = 0;
+        for (size_t from = 0; from < options.stop_count; ++from) {
+            for (size_t to = 0; to < options.stop_count; ++to) {
+                const std::string from_name = synthetic::StopName(from);
+                const std::string to_name = synthetic::StopName(to);
+                const std::string expected = DescribeRoute(all_pairs.GetRoute(from_name, to_name));
+                ASSERT_EQ(DescribeRoute(raptor.GetRoute(from_name, to_name)), expected)
+                    << "seed " << seed << ": " << from_name << " -> " << to_name;
+                route_count += expected != "none";
+            }
+        }
+        EXPECT_GT(route_count, options.stop_count);
+    }
+}
+
+// AUTO выбирает движок по числу запросов, но маршрут от выбора не зависит: один запрос
+// и тот же запрос в пакете из 20 тысяч получают одинаковые участки
+TEST(TransportRouterAutoTest, BatchSizeDoesNotChangeRoutes) {
+    for (const uint32_t seed : {1u, 2u, 3u}) {
+        TransportCatalogue catalogue;
+        synthetic::NetworkOptions options;
+        options.stop_count = 60;
+        options.bus_count = 20;
+        options.stops_per_bus = 8;
+        options.seed = seed;
+        synthetic::FillCatalogue(catalogue, options);
+
+        TransportRouter single(catalogue);
+        single.SetRoutingSettings(MakeSettings(1, 1));
+        single.CreateGraph();
+        TransportRouter batch(catalogue);
+        batch.SetRoutingSettings(MakeSettings(20000, options.stop_count));
+        batch.CreateGraph();
+        ASSERT_NE(single.GetStats().engine, batch.GetStats().engine);
+
+        for (size_t from = 0; from < options.stop_count; ++from) {
+            for (size_t to = 0; to < options.stop_count; ++to) {
+                const std::string from_name = synthetic::StopName(from);
+                const std::string to_name = synthetic::StopName(to);
+                ASSERT_EQ(DescribeRoute(single.GetRoute(from_name, to_name)), DescribeRoute(batch.GetRoute(from_name, to_name)))
+                    << "seed " << seed << ": " << from_name << " -> " << to_name;
+            }
+        }
+    }
+}
+
+// Маршруты между всеми парами остановок одной строкой на пару
+std::vector<std::string> DescribeAllRoutes(const TransportRouter& router, size_t stop_count) {
+    std::vector<std::string> routes;
+    for (size_t from = 0; from < stop_count; ++from) {
+        for (size_t to = 0; to < stop_count; ++to) {
+            routes.push_back(DescribeRoute(router.GetRoute(synthetic::StopName(from), synthetic::StopName(to))));
+        }
+    }
+    return routes;
+}
+
+// Расстояние, заданное после построения, меняет веса поездок прежних автобусов: UpdateDistances и AddBus
+// перестраивают роутер, и маршруты совпадают с роутером, построенным по новым данным с нуля
+TEST(TransportRouterTest, DistanceUpdateRebuildsRouter) {
+    for (const RouterEngine engine : {RouterEngine::ALL_PAIRS, RouterEngine::DIJKSTRA, RouterEngine::RAPTOR}) {
+        TransportCatalogue catalogue;
+        synthetic::NetworkOptions options;
+        options.stop_count = 60;
+        options.bus_count = 20;
+        options.stops_per_bus = 8;
+        synthetic::FillCatalogue(catalogue, options);
+        RoutingSettings settings = MakeSettings(0, 0);
+        settings.engine = engine;
+        TransportRouter router(catalogue);
+        router.SetRoutingSettings(settings);
+        const std::vector<std::string> before = DescribeAllRoutes(router, options.stop_count);
+
+        // Первый перегон автобуса становится очень длинным в обе стороны
+        const Bus& bus = catalogue.GetBus(0);
+        const std::string first = bus.stops[0]->name;
+        const std::string second = bus.stops[1]->name;
+        catalogue.AddDistance(first, second, 100000);
+        catalogue.AddDistance(second, first, 100000);
+        catalogue.FinalizeNewBuses();
+        router.UpdateDistances();
+        EXPECT_EQ(router.GetStats().distance_rebuild_count, 1u);
+
+        TransportRouter rebuilt(catalogue);
+        rebuilt.SetRoutingSettings(settings);
+        const std::vector<std::string> after = DescribeAllRoutes(rebuilt, options.stop_count);
+        EXPECT_NE(after, before);
+        EXPECT_EQ(DescribeAllRoutes(router, options.stop_count), after);
+
+        // Без UpdateDistances новое расстояние замечает AddBus и строит роутер заново, а не дописывает ребра
+        catalogue.AddDistance(first, second, 1);
+        catalogue.AddBus("New", {first, second}, false);
+        catalogue.FinalizeNewBuses();
+        EXPECT_FALSE(router.AddBus("New").incremental);
+        EXPECT_EQ(router.GetStats().distance_rebuild_count, 2u);
+        TransportRouter rebuilt_with_bus(catalogue);
+        rebuilt_with_bus.SetRoutingSettings(settings);
+        EXPECT_EQ(DescribeAllRoutes(router, options.stop_count), DescribeAllRoutes(rebuilt_with_bus, options.stop_count));
+    }
+}
+
+// Ребра топологии по порядку EdgeId: концы, расстояние, автобус и число пролетов
+std::vector<std::string> DescribeEdges(const TransportRouter& router) {
+    const auto& topology = router.GetTopology();
+    const auto& edges_info = router.GetEdgesInfo();
+    std::vector<std::string> edges;
+    edges.reserve(topology.size());
+    for (size_t edge = 0; edge < topology.size(); ++edge) {
+        edges.push_back(std::to_string(topology[edge].from) + ' ' + std::to_string(topology[edge].to) + ' '
+                        + std::to_string(topology[edge].distance) + ' ' + std::to_string(edges_info.at(edge).bus) + ' '
+                        + std::to_string(edges_info.at(edge).span_count));
+    }
+    return edges;
+}
+
+// Куски остановок строятся параллельно и сливаются по порядку: ребра, их нумерация и маршруты
+// таблицы всех пар, строки которой тоже считаются параллельно, не зависят от числа потоков
+TEST(TransportRouterTest, BuildDoesNotDependOnThreadCount) {
+    TransportCatalogue catalogue;
+    FillNetwork(catalogue, 200);
+    RoutingSettings settings = MakeSettings(0, 0);
+    settings.engine = RouterEngine::ALL_PAIRS;
+    settings.thread_count = 1;
+    TransportRouter single(catalogue);
+    single.SetRoutingSettings(settings);
+    single.CreateGraph();
+    const std::vector<std::string> edges = DescribeEdges(single);
+    ASSERT_FALSE(edges.empty());
+    const std::vector<std::string> routes = DescribeAllRoutes(single, 200);
+
+    for (const size_t thread_count : {2u, 7u, 64u}) {
+        settings.thread_count = thread_count;
+        TransportRouter parallel(catalogue);
+        parallel.SetRoutingSettings(settings);
+        parallel.CreateGraph();
+        EXPECT_EQ(DescribeEdges(parallel), edges) << thread_count;
+        EXPECT_EQ(parallel.GetStats().edge_count, single.GetStats().edge_count) << thread_count;
+        EXPECT_EQ(parallel.GetStats().dominated_edge_count, single.GetStats().dominated_edge_count) << thread_count;
+        EXPECT_EQ(DescribeAllRoutes(parallel, 200), routes) << thread_count;
+    }
+}
+
+// Автобус и число пролетов единственной поездки маршрута
+std::pair<std::string, int> GetRideBus(const transport_router::RouteInfo& route) {
+    std::vector<std::pair<std::string, int>> rides;
+    for (const auto& item : route.items_) {
+        if (const auto* bus = std::get_if<transport_router::WaitBusInfo>(&item)) {
+            rides.emplace_back(bus->bus_name_, bus->span_count_);
+        }
+    }
+    return rides.size() == 1 ? rides.front() : std::pair<std::string, int>{"", 0};
+}
+
+// Автобусы Direct (A - B) и Via (A - C - B) дают параллельные поездки A - B и B - A. В графе остается
+// одна поездка на пару: более короткая, а при равной длине - автобуса, добавленного первым
+TEST(TransportRouterTest, DominatedParallelEdgesAreDropped) {
+    struct Case {
+        int direct_distance;
+        bool direct_first;
+        std::pair<std::string, int> expected_ride;
+    };
+    for (const Case& test_case : {Case{3000, true, {"Via", 2}}, Case{3000, false, {"Via", 2}},
+                                  Case{2000, true, {"Direct", 1}}, Case{2000, false, {"Via", 2}}}) {
+        for (const RouterEngine engine : {RouterEngine::ALL_PAIRS, RouterEngine::DIJKSTRA}) {
+            TransportCatalogue catalogue;
+            catalogue.AddStop("A", {55.60, 37.60});
+            catalogue.AddStop("B", {55.61, 37.60});
+            catalogue.AddStop("C", {55.62, 37.60});
+            catalogue.AddDistance("A", "B", test_case.direct_distance);
+            catalogue.AddDistance("A", "C", 1000);
+            catalogue.AddDistance("C", "B", 1000);
+            if (test_case.direct_first) {
+                catalogue.AddBus("Direct", {"A", "B"}, false);
+            }
+            catalogue.AddBus("Via", {"A", "C", "B"}, false);
+            if (!test_case.direct_first) {
+                catalogue.AddBus("Direct", {"A", "B"}, false);
+            }
+            catalogue.Finalize();
+            RoutingSettings settings = MakeSettings(0, 0);
+            settings.engine = engine;
+            TransportRouter router(catalogue);
+            router.SetRoutingSettings(settings);
+            const std::string label = std::to_string(test_case.direct_distance) + (test_case.direct_first ? " direct first" : " via first");
+
+            const transport_router::RouteInfo forward = router.GetRoute("A", "B");
+            const transport_router::RouteInfo backward = router.GetRoute("B", "A");
+            EXPECT_EQ(GetRideBus(forward), test_case.expected_ride) << label;
+            EXPECT_EQ(GetRideBus(backward), test_case.expected_ride) << label;
+            ASSERT_TRUE(forward.total_time_.has_value()) << label;
+            EXPECT_NEAR(*forward.total_time_, 6 + std::min(test_case.direct_distance, 2000) * 60.0 / 40000, 1e-3) << label;
+
+            // 3 ожидания, 2 поездки Direct и 6 поездок Via, из которых 2 параллельные отброшены
+            const transport_router::RouterStats stats = router.GetStats();
+            EXPECT_EQ(stats.edge_count, 9u) << label;
+            EXPECT_EQ(stats.dominated_edge_count, 2u) << label;
+        }
+    }
+}
+
+// Настройки, замененные до первого запроса маршрута, не строятся: граф собирается один раз,
+// по последним настройкам и только при первом запросе
+TEST(TransportRouterTest, RouterIsBuiltLazilyOnce) {
+    TransportCatalogue catalogue;
+    FillNetwork(catalogue, 100);
+    RoutingSettings settings = MakeSettings(0, 0);
+    settings.engine = RouterEngine::ALL_PAIRS;
+    TransportRouter router(catalogue);
+    router.SetRoutingSettings(settings);
+    settings.engine = RouterEngine::DIJKSTRA;
+    router.SetRoutingSettings(settings);
+
+    transport_router::RouterStats stats = router.GetStats();
+    EXPECT_FALSE(stats.built);
+    EXPECT_EQ(stats.build_count, 0u);
+    EXPECT_EQ(stats.skipped_build_count, 2u);
+
+    const Bus& bus = catalogue.GetBus(0);
+    EXPECT_TRUE(router.GetRoute(bus.stops[0]->name, bus.stops[1]->name).total_time_.has_value());
+    EXPECT_TRUE(router.GetRoute(bus.stops[1]->name, bus.stops[0]->name).total_time_.has_value());
+    stats = router.GetStats();
+    EXPECT_TRUE(stats.built);
+    EXPECT_EQ(stats.build_count, 1u);
+    EXPECT_EQ(stats.skipped_build_count, 1u);
+    EXPECT_EQ(stats.engine, RouterEngine::DIJKSTRA);
+}
+
+// Движок профиля строится при первом запросе к нему, а не вместе с основным
+TEST(TransportRouterTest, ProfileEngineIsBuiltOnFirstQuery) {
+    TransportCatalogue catalogue;
+    FillNetwork(catalogue, 100);
+    RoutingSettings settings = MakeSettings(0, 0);
+    settings.engine = RouterEngine::DIJKSTRA;
+    settings.profiles.push_back({"slow", 6, 20});
+    TransportRouter router(catalogue);
+    router.SetRoutingSettings(settings);
+
+    const Bus& bus = catalogue.GetBus(0);
+    const std::string from = bus.stops[0]->name;
+    const std::string to = bus.stops[1]->name;
+    const transport_router::RouteInfo main_route = router.GetRoute(from, to);
+    std::vector<transport_router::ProfileStats> profiles = router.GetStats().profiles;
+    ASSERT_EQ(profiles.size(), 2u);
+    EXPECT_TRUE(profiles[0].built);
+    EXPECT_EQ(profiles[1].name, "slow");
+    EXPECT_FALSE(profiles[1].built);
+
+    const transport_router::RouteInfo slow_route = router.GetRoute(from, to, "slow");
+    EXPECT_TRUE(router.GetStats().profiles[1].built);
+    ASSERT_TRUE(main_route.total_time_.has_value());
+    ASSERT_TRUE(slow_route.total_time_.has_value());
+    EXPECT_GT(*slow_route.total_time_, *main_route.total_time_);
+    EXPECT_THROW(router.GetRoute(from, to, "fast"), std::invalid_argument);
+}
+
+// Таблица всех пар ищет по точным целым весам, поэтому время каждого маршрута - кратчайшее,
+// как у Дейкстры, а не в пределах округления float
+TEST(TransportRouterTest, AllPairsRoutesAreOptimal) {
+    TransportCatalogue catalogue;
+    synthetic::NetworkOptions options;
+    options.stop_count = 300;
+    options.bus_count = 80;
+    options.seed = 2;
+    synthetic::FillCatalogue(catalogue, options);
+
+    RoutingSettings settings = MakeSettings(0, 0);
+    settings.engine = RouterEngine::ALL_PAIRS;
+    TransportRouter all_pairs(catalogue);
+    all_pairs.SetRoutingSettings(settings);
+    settings.engine = RouterEngine::DIJKSTRA;
+    TransportRouter dijkstra(catalogue);
+    dijkstra.SetRoutingSettings(settings);
+
+    size_t route_count = 0;
+    for (size_t from = 0; from < options.stop_count; from += 7) {
+        for (size_t to = 0; to < options.stop_count; to += 5) {
+            const std::string from_name = synthetic::StopName(from);
+            const std::string to_name = synthetic::StopName(to);
+            const auto route = all_pairs.GetRoute(from_name, to_name);
+            const auto expected = dijkstra.GetRoute(from_name, to_name);
+            ASSERT_EQ(route.total_time_.has_value(), expected.total_time_.has_value()) << from_name << " -> " << to_name;
+            if (route.total_time_) {
+                EXPECT_NEAR(*route.total_time_, *expected.total_time_, 1e-9) << from_name << " -> " << to_name;
+                ++route_count;
+            }
+        }
+    }
+    EXPECT_GT(route_count, 0u);
+}
+
+}  // namespace
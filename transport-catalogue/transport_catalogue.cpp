@@ -1,59 +1,40 @@
 #include "transport_catalogue.h"
+#include "parallel.h"
 
 #include <iostream>
 #include <algorithm>
+#include <chrono>
 #include <unordered_set>
 
 namespace transport_catalogue {
     
-    BusSectionInfo TransportCatalogue::FindBusNameByTwoStopsAndDistance(std::string_view first_stop, std::string_view second_stop, double distance) const{
-        const double EPSILON = 1e-6;
-        for(auto bus : buses_){
-            std::string last_stop_name;
-            double sum_distance = 0;
-            int count_stops = 0;
-
-            for(auto begin_ = find(bus.stops.begin(), bus.stops.end(), FindStop(first_stop)); begin_ != bus.stops.end(); begin_ =  find(next(begin_), bus.stops.end(), FindStop(first_stop))){
-                for(auto end_ = find(bus.stops.begin(), bus.stops.end(), FindStop(second_stop)); end_ != bus.stops.end(); end_ = find(next(end_), bus.stops.end(), FindStop(second_stop))){
-                    for(auto iter = begin_; iter != next(end_, 1); iter++){
-                        if(!last_stop_name.empty()){
-                            sum_distance += FindDistance(last_stop_name, (*iter)->name);
-                            if(sum_distance > distance){
-                                break;
-                            }
-                            count_stops++;
-                        }
-                        last_stop_name = (*iter)->name;
-                        if(next(iter, 1) != next(end_, 1) && next(iter, 1) == bus.stops.end()){
-                            iter = next(bus.stops.begin(), -1);
-                            if(bus.is_round){
-                                count_stops--;
-                            }
-                        }
-                    }
-                    if(std::abs(distance - sum_distance) < EPSILON){
-                        return BusSectionInfo{bus.name, count_stops};
-                    }
-                }
-            }
-        }
-        return BusSectionInfo{std::string{}, 0};
-    }
-
     void TransportCatalogue::AddStop(const std::string& name, geo::Coordinates coord){
-        stops_.push_back({name, std::move(coord)});
+        finalized_ = false;
+        stops_.push_back({name, std::move(coord), static_cast<StopId>(stops_.size())});
         stops_points_[stops_.back().name] = &stops_.back();
-        stop_to_buses_[stops_.back().name] = {};
+        stop_to_buses_.emplace_back();
+
+        //Расстояния до этой остановки могли прийти раньше нее самой
+        auto pending = pending_distances_.extract(name);
+        if(!pending.empty()){
+            for(const auto& [stop_from, stop_to, distance] : pending.mapped()){
+                AddDistance(stop_from, stop_to, distance);
+            }
+        }
     }
 
     void TransportCatalogue::AddBus(const std::string& name, const std::vector<std::string_view>& stops_name, bool is_round){
+        finalized_ = false;
         std::vector<const Stop*> stops;
-        buses_.push_back({name, {}, is_round});
+        const BusId id = static_cast<BusId>(buses_.size());
+        buses_.push_back({name, {}, is_round, id, {}, {}});
         for(const auto& stop_name : stops_name){
             auto stop = FindStop(stop_name);
             stops.push_back(stop);
-            if(std::count(stop_to_buses_.at(stops.back()->name).begin(), stop_to_buses_.at(stops.back()->name).end(), buses_.back().name) == 0){
-                stop_to_buses_[stops.back()->name].push_back(buses_.back().name);
+            //Автобус добавляется последним, поэтому повтор может быть только в конце списка
+            std::vector<BusId>& stop_buses = stop_to_buses_.at(stop->id);
+            if(stop_buses.empty() || stop_buses.back() != id){
+                stop_buses.push_back(id);
             }
         }
         buses_.back().stops = std::move(stops);
@@ -61,9 +42,124 @@ namespace transport_catalogue {
     }
 
     void TransportCatalogue::AddDistance(const std::string& stop_from, const std::string& stop_to, int distance){
-        if(!stop_from.empty() && !stop_from.empty()){
-            distances_[{stop_from, stop_to}] = distance;
+        if(stop_from.empty() || stop_to.empty()){
+            return;
+        }
+        const Stop* from = FindStop(stop_from);
+        const Stop* to = FindStop(stop_to);
+        if(from == nullptr || to == nullptr){
+            pending_distances_[from == nullptr ? stop_from : stop_to].push_back({stop_from, stop_to, distance});
+            return;
+        }
+        if(distances_frozen_){
+            ThawDistances();
+        }
+        finalized_ = false;
+        distances_[{from->id, to->id}] = distance;
+        ++distances_version_;
+    }
+
+    void TransportCatalogue::FreezeDistances(){
+        if(distances_frozen_){
+            return;
+        }
+        const size_t stops_count = stops_.size();
+        distance_offsets_.assign(stops_count + 1, 0);
+
+        //Первый проход считает длины строк, обратное направление подставляется сразу
+        for(const auto& [stops, distance] : distances_){
+            distance_offsets_[stops.first + 1]++;
+            if(!distances_.count({stops.second, stops.first})){
+                distance_offsets_[stops.second + 1]++;
+            }
+        }
+        for(size_t i = 0; i < stops_count; i++){
+            distance_offsets_[i + 1] += distance_offsets_[i];
         }
+
+        road_distances_.resize(distance_offsets_.back());
+        std::vector<uint32_t> positions(distance_offsets_.begin(), distance_offsets_.end() - 1);
+        for(const auto& [stops, distance] : distances_){
+            road_distances_[positions[stops.first]++] = {stops.second, distance, false};
+            if(!distances_.count({stops.second, stops.first})){
+                road_distances_[positions[stops.second]++] = {stops.first, distance, true};
+            }
+        }
+        for(size_t i = 0; i < stops_count; i++){
+            std::sort(road_distances_.begin() + distance_offsets_[i], road_distances_.begin() + distance_offsets_[i + 1], [](const auto& lhs, const auto& rhs){
+                return lhs.to < rhs.to;
+            });
+        }
+
+        decltype(distances_)().swap(distances_);
+        distances_frozen_ = true;
+    }
+
+    void TransportCatalogue::Finalize(size_t thread_count){
+        const auto start = std::chrono::steady_clock::now();
+        FreezeDistances();
+
+        bus_infos_.resize(buses_.size());
+        parallel::ForEachChunk(buses_.size(), thread_count, [this](size_t begin, size_t end){
+            for(size_t i = begin; i < end; i++){
+                FillRoadDistances(buses_[i]);
+                bus_infos_[i] = ComputeInfo(buses_[i]);
+            }
+        });
+        finalized_ = true;
+        finalized_bus_count_ = buses_.size();
+
+        finalize_stats_.buses_count = buses_.size();
+        finalize_stats_.thread_count = thread_count;
+        finalize_stats_.duration_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void TransportCatalogue::FinalizeNewBuses(size_t thread_count){
+        if(!distances_frozen_ || finalized_bus_count_ == 0){
+            Finalize(thread_count);
+            return;
+        }
+        const auto start = std::chrono::steady_clock::now();
+        //Новая остановка без расстояний не меняет ни таблицу, ни сведения прежних автобусов
+        const size_t first_bus = finalized_bus_count_;
+        bus_infos_.resize(buses_.size());
+        parallel::ForEachChunk(buses_.size() - first_bus, thread_count, [this, first_bus](size_t begin, size_t end){
+            for(size_t i = first_bus + begin; i < first_bus + end; i++){
+                FillRoadDistances(buses_[i]);
+                bus_infos_[i] = ComputeInfo(buses_[i]);
+            }
+        });
+        finalize_stats_.buses_count = buses_.size() - first_bus;
+        finalize_stats_.thread_count = thread_count;
+        finalized_ = true;
+        finalized_bus_count_ = buses_.size();
+        finalize_stats_.duration_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    const FinalizeStats& TransportCatalogue::GetFinalizeStats() const{
+        return finalize_stats_;
+    }
+
+    bool TransportCatalogue::IsFinalized() const{
+        return finalized_;
+    }
+
+    size_t TransportCatalogue::GetDistancesVersion() const{
+        return distances_version_;
+    }
+
+    void TransportCatalogue::ThawDistances(){
+        for(size_t from = 0; from + 1 < distance_offsets_.size(); from++){
+            for(uint32_t i = distance_offsets_[from]; i < distance_offsets_[from + 1]; i++){
+                if(!road_distances_[i].is_reverse){
+                    distances_[{static_cast<StopId>(from), road_distances_[i].to}] = road_distances_[i].distance;
+                }
+            }
+        }
+        decltype(distance_offsets_)().swap(distance_offsets_);
+        decltype(road_distances_)().swap(road_distances_);
+        distances_frozen_ = false;
+        finalized_bus_count_ = 0;
     }
 
     const std::unordered_map<std::string_view, const Bus*>& TransportCatalogue::GetBusesPoints() const{
@@ -78,64 +174,98 @@ namespace transport_catalogue {
     }
 
     const Stop* TransportCatalogue::FindStop(std::string_view name) const{
-        if(stops_points_.count(name)){
-            return stops_points_.at(name);
+        if(auto it = stops_points_.find(name); it != stops_points_.end()){
+            return it->second;
         }
         return nullptr;
     }
 
     std::optional<int> TransportCatalogue::FindStopIndex(std::string_view name) const{
-        int index = 0;
-        for(auto stop : stops_){
-            if(stop.name == name){
-                return index;
-            }
-            index++;
+        if(const Stop* stop = FindStop(name)){
+            return static_cast<int>(stop->id);
         }
         return std::nullopt;
     }
 
-    const std::vector<std::string_view>& TransportCatalogue::FindStopToBus(std::string_view stop_name) const{
-        return stop_to_buses_.at(stop_name);
+    const std::vector<BusId>& TransportCatalogue::BusesThrough(StopId stop) const{
+        return stop_to_buses_.at(stop);
     }
 
     int TransportCatalogue::FindDistance(const std::string& stop_from, const std::string& stop_to) const{
-        if(distances_.count({stop_from, stop_to})){
-            return distances_.at({stop_from, stop_to});
+        const Stop* from = FindStop(stop_from);
+        const Stop* to = FindStop(stop_to);
+        if(from == nullptr || to == nullptr){
+            return 0;
+        }
+        return FindDistance(from->id, to->id);
+    }
+
+    int TransportCatalogue::FindDistance(StopId stop_from, StopId stop_to) const{
+        if(distances_frozen_){
+            if(static_cast<size_t>(stop_from) + 1 >= distance_offsets_.size()){
+                return 0;
+            }
+            for(uint32_t i = distance_offsets_[stop_from]; i < distance_offsets_[stop_from + 1]; i++){
+                if(road_distances_[i].to == stop_to){
+                    return road_distances_[i].distance;
+                }
+            }
+            return 0;
         }
-        if(distances_.count({stop_to, stop_from})){
-            return distances_.at({stop_to, stop_from});
+        if(auto it = distances_.find({stop_from, stop_to}); it != distances_.end()){
+            return it->second;
+        }
+        if(auto it = distances_.find({stop_to, stop_from}); it != distances_.end()){
+            return it->second;
         }
         return 0;
     }
 
     BusInfo TransportCatalogue::GetInfo(const Bus* bus) const{
-        BusInfo info;
         if(bus == nullptr){
             return BusInfo{};
         }
+        if(finalized_){
+            return bus_infos_[bus->id];
+        }
+        //Без Finalize накопленные расстояния могут быть устаревшими, считаем их на копии
+        Bus filled_bus = *bus;
+        FillRoadDistances(filled_bus);
+        return ComputeInfo(filled_bus);
+    }
+
+    void TransportCatalogue::FillRoadDistances(Bus& bus) const{
+        const size_t stops_count = bus.stops.size();
+        bus.forward_distances.assign(stops_count, 0);
+        bus.backward_distances.assign(stops_count, 0);
+        for(size_t i = 1; i < stops_count; i++){
+            bus.forward_distances[i] = bus.forward_distances[i - 1] + FindDistance(bus.stops[i - 1]->id, bus.stops[i]->id);
+            bus.backward_distances[i] = bus.backward_distances[i - 1] + FindDistance(bus.stops[i]->id, bus.stops[i - 1]->id);
+        }
+    }
 
-        info.stops_route = static_cast<int>(bus->stops.size());
-        info.unique_stops = static_cast<int>(std::unordered_set<const Stop*>(bus->stops.begin(), bus->stops.end()).size());
+    BusInfo TransportCatalogue::ComputeInfo(const Bus& bus) const{
+        //У автобуса без остановок нет ни маршрута, ни накопленных расстояний
+        if(bus.stops.empty()){
+            return BusInfo{0, 0, 0, 0.0};
+        }
+        BusInfo info;
+        info.stops_route = static_cast<int>(bus.stops.size());
+        info.unique_stops = static_cast<int>(std::unordered_set<const Stop*>(bus.stops.begin(), bus.stops.end()).size());
 
         double length = 0;
         geo::Coordinates last_coord = {};
-        for(const auto i : bus->stops){
+        for(const auto i : bus.stops){
             if(last_coord != geo::Coordinates{}){
                 length += geo::ComputeDistance(last_coord, i->coordinates);
             }
-            last_coord = const_cast<Stop*>(i)->coordinates;
+            last_coord = i->coordinates;
         }
 
-        info.length = 0;
-        for(long long unsigned int i = 0; i < bus->stops.size() - 1; i++){
-            info.length += FindDistance(bus->stops.at(i)->name, bus->stops.at(i + 1)->name);
-        }
+        info.length = bus.forward_distances.back();
 
-        if(bus->is_round == false){
-            for(long long unsigned int i = bus->stops.size() - 1; i > 0; i--){
-                info.length += FindDistance(bus->stops.at(i)->name, bus->stops.at(i - 1)->name);
-            }
+        if(bus.is_round == false){
+            info.length += bus.backward_distances.back();
             info.stops_route = info.stops_route * 2 - 1;
             length *= 2;
         }
@@ -145,10 +275,16 @@ namespace transport_catalogue {
     }
 
     std::vector<std::string_view> TransportCatalogue::GetStopInfo(std::string_view name) const{
-        if(stop_to_buses_.count(name)){
-            return stop_to_buses_.at(name);
+        const Stop* stop = FindStop(name);
+        if(stop == nullptr){
+            return {};
+        }
+        std::vector<std::string_view> buses;
+        buses.reserve(stop_to_buses_[stop->id].size());
+        for(BusId bus : stop_to_buses_[stop->id]){
+            buses.push_back(buses_[bus].name);
         }
-        return {};
+        return buses;
     }
 
     size_t TransportCatalogue::GetStopsCount() const{
@@ -162,4 +298,12 @@ namespace transport_catalogue {
     const std::deque<Bus>& TransportCatalogue::GetBuses() const{
         return buses_;
     }
+
+    const Stop& TransportCatalogue::GetStop(StopId stop) const{
+        return stops_.at(stop);
+    }
+
+    const Bus& TransportCatalogue::GetBus(BusId bus) const{
+        return buses_.at(bus);
+    }
 }
\ No newline at end of file
@@ -14,19 +14,33 @@ namespace transport_catalogue {
 
 	namespace details{
 		
-		struct StringPairHashes{
-			size_t operator()(std::pair<std::string, std::string> other) const {
-				std::hash<std::string> hasher;
-				return hasher(other.first) * 37 + hasher(other.second) * 37 * 37;
+		struct StopIdPairHasher{
+			size_t operator()(std::pair<StopId, StopId> other) const {
+				return std::hash<uint64_t>{}((static_cast<uint64_t>(other.first) << 32) | other.second);
 			}
 		};
-	}
 
-	struct BusSectionInfo{
-		std::string bus_name_;
-		int count_stops_;
+		// Элемент строки CSR-таблицы расстояний. is_reverse отмечает расстояние,
+		// подставленное из обратного направления при заморозке
+		struct RoadDistance{
+			StopId to;
+			int distance;
+			bool is_reverse;
+		};
+
+		// Расстояние, у которого одна из остановок еще не добавлена
+		struct PendingDistance{
+			std::string stop_from;
+			std::string stop_to;
+			int distance;
+		};
+	}
 
-		BusSectionInfo(std::string bus_name, int count_stops) : bus_name_(bus_name), count_stops_(count_stops){}
+	// Стоимость последнего вызова Finalize
+	struct FinalizeStats{
+		size_t buses_count = 0;
+		size_t thread_count = 0;
+		double duration_ms = 0;
 	};
 
 	struct DistanceToStop{
@@ -42,27 +56,56 @@ namespace transport_catalogue {
 		void AddStop(const std::string& name, geo::Coordinates coord);
 		void AddBus(const std::string& name, const std::vector<std::string_view>& stops_name, bool is_round);
 		void AddDistance(const std::string& stop_from, const std::string& stop_to, int distance);
+		// Переводит расстояния в компактную CSR-таблицу. Вызывается после загрузки базы,
+		// последующий AddDistance возвращает таблицу в хеш-таблицу
+		void FreezeDistances();
+		// Замораживает расстояния и заранее считает BusInfo для всех автобусов.
+		// Любое последующее добавление данных сбрасывает результат
+		void Finalize(size_t thread_count = 1);
+		// Досчитывает сведения только автобусов, добавленных после последнего Finalize, если расстояния
+		// с тех пор не менялись. Иначе сведения прежних автобусов могли устареть, и делается полный Finalize
+		void FinalizeNewBuses(size_t thread_count = 1);
+		const FinalizeStats& GetFinalizeStats() const;
+		bool IsFinalized() const;
+		// Растет при каждом заданном расстоянии: по нему роутер замечает, что веса его поездок устарели
+		size_t GetDistancesVersion() const;
 
 		const Bus* FindBus(std::string_view name) const;
 		int FindDistance(const std::string& stop_from, const std::string& stop_to) const;
+		int FindDistance(StopId stop_from, StopId stop_to) const;
 		const Stop* FindStop(std::string_view name) const;
 		std::optional<int> FindStopIndex(std::string_view name) const;
-		const std::vector<std::string_view>& FindStopToBus(std::string_view stop_name) const;
-		BusSectionInfo FindBusNameByTwoStopsAndDistance(std::string_view first_stop, std::string_view second_stop, double distance) const;
+		const std::vector<BusId>& BusesThrough(StopId stop) const;
 
 		const std::deque<Stop>& GetStops() const;
 		const std::deque<Bus>& GetBuses() const;
+		const Stop& GetStop(StopId stop) const;
+		const Bus& GetBus(BusId bus) const;
 		size_t GetStopsCount() const;
 		const std::unordered_map<std::string_view, const Bus*>& GetBusesPoints() const;
 		BusInfo GetInfo(const Bus* bus) const;
 
 		std::vector<std::string_view> GetStopInfo(std::string_view name) const;
 	private:
+		void ThawDistances();
+		void FillRoadDistances(Bus& bus) const;
+		BusInfo ComputeInfo(const Bus& bus) const;
+
 		std::deque<Stop> stops_;
 		std::deque<Bus> buses_;
 		std::unordered_map<std::string_view, const Stop*> stops_points_;
 		std::unordered_map<std::string_view, const Bus*> buses_points_;
-		std::unordered_map<std::string_view, std::vector<std::string_view>> stop_to_buses_;
-		std::unordered_map<std::pair<std::string, std::string>, int, details::StringPairHashes> distances_;
+		std::vector<std::vector<BusId>> stop_to_buses_;
+		std::unordered_map<std::pair<StopId, StopId>, int, details::StopIdPairHasher> distances_;
+		bool distances_frozen_ = false;
+		size_t distances_version_ = 0;
+		std::vector<uint32_t> distance_offsets_;
+		std::vector<details::RoadDistance> road_distances_;
+		std::unordered_map<std::string, std::vector<details::PendingDistance>> pending_distances_;
+		bool finalized_ = false;
+		// Автобусы, сведения которых посчитаны по текущим расстояниям; ThawDistances обнуляет
+		size_t finalized_bus_count_ = 0;
+		std::vector<BusInfo> bus_infos_;
+		FinalizeStats finalize_stats_;
 	};
 }
\ No newline at end of file
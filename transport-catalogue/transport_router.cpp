@@ -1,75 +1,424 @@
 #include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <deque>
+#include <map>
+#include <numeric>
 #include <vector>
 #include <optional>
+#include <tuple>
 
 #include "transport_router.h"
 #include "router.h"
 #include "domain.h"
+#include "parallel.h"
 
 namespace transport_router{
 using namespace json;
 
 const double CoefficientSpeedConversion = 16.66666;
+const RouteWeight TicksPerMeter = RouteWeight{1} << 16;
 
 namespace details{
-    template <typename It>
-    void ParseBusToEdges(It begin, It end, double bus_velocity, const transport_catalogue::TransportCatalogue& catalogue, graph::DirectedWeightedGraph<double>& graph){
-        for(auto iter = begin; iter != end; iter++){
-            std::string first_stop_name = (*iter)->name;
-            std::string last_stop_name = first_stop_name;
-            std::optional<int> first_index = catalogue.FindStopIndex(first_stop_name);
-            double distance_sum = 0;
-            if(!first_index){
-                throw std::runtime_error("stop is not found");
-            }
-            first_index = first_index.value() * 2 + 1;
-            for(auto j_iter = next(iter, 1); j_iter != end; j_iter++){
-                std::string second_stop_name = (*j_iter)->name;
-                std::optional<int> second_index = catalogue.FindStopIndex(second_stop_name);
-                distance_sum += catalogue.FindDistance(last_stop_name, second_stop_name);
-                if(!first_index){
-                    throw std::runtime_error("stop is not found");
+    //Веса шагов в оценке подобраны по замерам diagnostics на двух сетях: 1600 вершин / 21 тыс. ребер
+    //и 6000 вершин / 72 тыс. ребер, 200 и 2000 запросов Route. Шаг Дейкстры с кучей обошелся в 1.6-2 нс,
+    //ячейка Флойда-Уоршелла на SIMD-ядре - около 0.4 нс, отсюда отношение 1 к 4. Поиск до цели
+    //останавливается на извлечении цели и в среднем просматривает около половины графа
+    const double AllPairsStepCost = 1.0;
+    const double DijkstraStepCost = 4.0;
+    const double EarlyExitFraction = 0.5;
+    //Иерархия сжатия: на сети из 6000 вершин предобработка заняла 4 с - порядка полупоиска Дейкстры
+    //на вершину, запрос - 190 мкс против 500 мкс у Дейкстры, то есть около 0.2 полного поиска.
+    //Ярлыков обычно не больше исходных ребер, поэтому дуг - не больше двух на ребро
+    const double ContractionSearchesPerVertex = 0.5;
+    const double ContractionQueryFraction = 0.2;
+    const size_t ContractionArcsPerEdge = 2;
+    //Метки хабов: построение - отсекаемые поиски от каждой вершины в обе стороны, на той же сети 3.2 с,
+    //около трети полного поиска на поиск. В метке порядка LabelEntriesPerVertex записей (вершина и вес),
+    //запрос сливает прямую и обратную метки; замеренные 6 мкс на запрос здесь занижены, но на выбор
+    //влияют только при числе запросов, сравнимом с числом вершин в квадрате
+    const double LabelSearchFraction = 0.3;
+    const double LabelEntriesPerVertex = 128;
+    const size_t LabelEntryBytes = 16;
+    const double LabelDirections = 2;
+    //RAPTOR: в каждом раунде просматривается часть позиций линий, раундов до стабилизации - около
+    //десятка; на сети из 6000 вершин запрос занял 260 мкс, около 5 нс на просмотренную позицию.
+    //Прибытия раундов хранятся для половины вершин графа - для остановок
+    const double RaptorRoundCount = 10;
+    const double RaptorScanFraction = 0.5;
+    const size_t RaptorVerticesPerStop = 2;
+
+    double DijkstraSearchSteps(size_t vertex_count, size_t edge_count){
+        const double vertices = static_cast<double>(vertex_count);
+        return (static_cast<double>(edge_count) + vertices * std::log2(vertices + 1)) * DijkstraStepCost;
+    }
+
+    //Число ребер графа без его построения: ожидание на каждой остановке и пары остановок каждой линии
+    size_t CountGraphEdges(const transport_catalogue::TransportCatalogue& catalogue){
+        size_t edge_count = catalogue.GetStopsCount();
+        for(const Bus& bus : catalogue.GetBuses()){
+            const size_t stops_count = bus.stops.size();
+            edge_count += stops_count * (stops_count - std::min<size_t>(stops_count, 1)) / 2 * (bus.is_round ? 1 : 2);
+        }
+        return edge_count;
+    }
+
+    std::map<RouterEngine, EngineEstimate> EstimateEngines(size_t vertex_count, size_t edge_count, size_t line_positions, const RoutingSettings& settings){
+        const double vertices = static_cast<double>(vertex_count);
+        const double queries = static_cast<double>(settings.expected_queries);
+        const double sources = static_cast<double>(settings.expected_sources);
+        const double search_steps = DijkstraSearchSteps(vertex_count, edge_count);
+        const size_t search_memory = vertex_count * (sizeof(double) + sizeof(graph::EdgeId) + sizeof(uint32_t));
+
+        std::map<RouterEngine, EngineEstimate> estimates;
+        estimates[RouterEngine::ALL_PAIRS] = {graph::Router<RouteWeight>::EstimateMemory(vertex_count), vertices * vertices * vertices * AllPairsStepCost / static_cast<double>(std::max<size_t>(1, settings.thread_count))};
+        estimates[RouterEngine::DIJKSTRA] = {search_memory, queries * search_steps * EarlyExitFraction};
+        //Деревья сверх бюджета кэша вытесняются, и запросы из их источников ищут заново
+        const size_t tree_bytes = graph::ShortestPathTree<RouteWeight>::EstimateMemory(vertex_count);
+        const size_t cached_trees = std::min(settings.expected_sources, settings.source_cache_bytes / tree_bytes);
+        const double miss_fraction = sources > 0 ? 1.0 - static_cast<double>(cached_trees) / sources : 0.0;
+        estimates[RouterEngine::SOURCE_CACHED] = {search_memory + cached_trees * tree_bytes,
+                                                  (sources + std::max(0.0, queries - sources) * miss_fraction) * search_steps};
+        estimates[RouterEngine::CONTRACTION_HIERARCHY] = {search_memory * 2 + edge_count * ContractionArcsPerEdge * (sizeof(double) + 2 * sizeof(graph::EdgeId)),
+                                                          (vertices * ContractionSearchesPerVertex + queries * ContractionQueryFraction) * search_steps};
+        estimates[RouterEngine::HUB_LABELS] = {static_cast<size_t>(LabelDirections * vertices * LabelEntriesPerVertex) * LabelEntryBytes,
+                                               LabelDirections * vertices * LabelSearchFraction * search_steps / static_cast<double>(std::max<size_t>(1, settings.thread_count))
+                                               + queries * LabelDirections * LabelEntriesPerVertex};
+        estimates[RouterEngine::RAPTOR] = {line_positions * (sizeof(StopId) + sizeof(int) + 2 * sizeof(uint32_t))
+                                               + static_cast<size_t>(RaptorRoundCount) * vertex_count / RaptorVerticesPerStop * sizeof(RouteWeight),
+                                           queries * RaptorRoundCount * RaptorScanFraction * static_cast<double>(line_positions)};
+        return estimates;
+    }
+
+    //Самый дешевый движок из помещающихся в лимит памяти, при равенстве - раньше в перечислении.
+    //Из равных по времени маршрутов все движки выбирают один и тот же, поэтому выбор меняет только
+    //стоимость, а не ответ
+    RouterEngine ChooseEngine(const std::map<RouterEngine, EngineEstimate>& estimates, size_t memory_limit_bytes){
+        std::optional<RouterEngine> best;
+        for(const auto& [engine, estimate] : estimates){
+            if(estimate.memory_bytes > memory_limit_bytes){
+                continue;
+            }
+            if(!best || estimate.operations < estimates.at(*best).operations){
+                best = engine;
+            }
+        }
+        return best.value_or(RouterEngine::DIJKSTRA);
+    }
+
+    //Вхождение остановки в автобус, идущий в одном направлении. position - номер остановки по ходу движения
+    struct StopVisit{
+        const Bus* bus;
+        bool reverse;
+        size_t position;
+    };
+
+    //Ребра и их описания, собранные одним потоком
+    struct EdgeBuffer{
+        std::vector<TopologyEdge> edges;
+        std::vector<EdgeInfo> edges_info;
+    };
+
+    //Вхождения остановки s во все автобусы - visits[offsets[s]..offsets[s + 1]): по порядку автобусов,
+    //у некольцевого автобуса прямое направление раньше обратного
+    void CollectStopVisits(const transport_catalogue::TransportCatalogue& catalogue, std::vector<size_t>& offsets, std::vector<StopVisit>& visits){
+        const std::deque<Bus>& buses = catalogue.GetBuses();
+        offsets.assign(catalogue.GetStopsCount() + 1, 0);
+        for(const Bus& bus : buses){
+            for(const Stop* stop : bus.stops){
+                offsets[stop->id + 1] += bus.is_round ? 1 : 2;
+            }
+        }
+        for(size_t stop = 0; stop + 1 < offsets.size(); stop++){
+            offsets[stop + 1] += offsets[stop];
+        }
+        visits.resize(offsets.back());
+        std::vector<size_t> positions(offsets.begin(), offsets.end() - 1);
+        for(const Bus& bus : buses){
+            const size_t stops_count = bus.stops.size();
+            for(const bool reverse : {false, true}){
+                if(reverse && bus.is_round){
+                    continue;
+                }
+                for(size_t i = 0; i < stops_count; i++){
+                    const StopId stop = bus.stops[reverse ? stops_count - 1 - i : i]->id;
+                    visits[positions[stop]++] = {&bus, reverse, i};
+                }
+            }
+        }
+    }
+
+    //Ребра из остановки stop: ожидание и поездки без пересадки до каждой следующей остановки автобусов.
+    //Из параллельных поездок в одну вершину остается самая короткая, при равенстве - первая: скорость
+    //у всех автобусов профиля одна, поэтому маршрут по отброшенной не быстрее ни в одном профиле.
+    //target_edges[v] - позиция ребра в v в буфере, если target_marks[v] == stop. Возвращает число отброшенных поездок
+    size_t AddStopEdges(StopId stop, const StopVisit* visits_begin, const StopVisit* visits_end,
+                        std::vector<size_t>& target_marks, std::vector<size_t>& target_edges, EdgeBuffer& buffer){
+        buffer.edges.push_back({stop * 2, stop * 2 + 1, 0});
+        buffer.edges_info.push_back({0, 0});
+        const graph::VertexId first_index = stop * 2 + 1;
+        size_t dominated_count = 0;
+        for(const StopVisit* visit = visits_begin; visit != visits_end; visit++){
+            const Bus& bus = *visit->bus;
+            const size_t stops_count = bus.stops.size();
+            const size_t from = visit->reverse ? stops_count - 1 - visit->position : visit->position;
+            for(size_t j = visit->position + 1; j < stops_count; j++){
+                const size_t to = visit->reverse ? stops_count - 1 - j : j;
+                const graph::VertexId second_index = bus.stops[to]->id * 2;
+                const TopologyEdge edge{static_cast<uint32_t>(first_index), static_cast<uint32_t>(second_index), bus.GetRoadDistance(from, to)};
+                const EdgeInfo edge_info{bus.id, static_cast<int>(j - visit->position)};
+                if(target_marks[second_index] != stop){
+                    target_marks[second_index] = stop;
+                    target_edges[second_index] = buffer.edges.size();
+                    buffer.edges.push_back(edge);
+                    buffer.edges_info.push_back(edge_info);
+                    continue;
+                }
+                dominated_count++;
+                const size_t position = target_edges[second_index];
+                if(edge.distance < buffer.edges[position].distance){
+                    buffer.edges[position] = edge;
+                    buffer.edges_info[position] = edge_info;
                 }
-                second_index = second_index.value() * 2;
-                graph.AddEdge(graph::Edge<double>(static_cast<size_t>(*first_index), static_cast<size_t>(*second_index), distance_sum / static_cast<double>(bus_velocity * CoefficientSpeedConversion)));
-                last_stop_name = second_stop_name;
             }
-            distance_sum = 0;
         }
+        return dominated_count;
+    }
+
+    bool IsWaitEdge(const TopologyEdge& edge){
+        return edge.from % 2 == 0 && edge.to - edge.from == 1;
+    }
+
+    double GetSpeed(const RoutingProfile& profile){
+        return profile.bus_velocity * CoefficientSpeedConversion;
+    }
+
+    //Тиков в минуте: столько тиков проезжает автобус профиля за минуту
+    double GetTicksPerMinute(const RoutingProfile& profile){
+        return GetSpeed(profile) * TicksPerMeter;
+    }
+
+    //Время ребра в минутах без округления до тиков: ожидание - bus_wait_time, поездка - расстояние на скорость
+    double GetEdgeTime(const TopologyEdge& edge, const RoutingProfile& profile){
+        return IsWaitEdge(edge) ? profile.bus_wait_time : edge.distance / GetSpeed(profile);
+    }
+
+    //Вес ожидания профиля в тиках. Вес не меньше тика, чтобы в графе не было циклов нулевого веса
+    RouteWeight GetWaitWeight(const RoutingProfile& profile){
+        return std::max<RouteWeight>(1, std::llround(profile.bus_wait_time * GetTicksPerMinute(profile)));
+    }
+
+    //Ребра профиля по куску топологии: ожидание - bus_wait_time, поездка - расстояние, в тиках.
+    //Поездка тоже весит не меньше тика
+    std::vector<graph::Edge<RouteWeight>> MakeProfileEdges(std::vector<TopologyEdge>::const_iterator begin, std::vector<TopologyEdge>::const_iterator end,
+                                                           const RoutingProfile& profile){
+        std::vector<graph::Edge<RouteWeight>> edges;
+        edges.reserve(end - begin);
+        const RouteWeight wait_weight = GetWaitWeight(profile);
+        for(auto edge = begin; edge != end; edge++){
+            edges.emplace_back(edge->from, edge->to, IsWaitEdge(*edge) ? wait_weight : std::max<RouteWeight>(1, edge->distance * TicksPerMeter));
+        }
+        return edges;
+    }
+
+    //Взвешенный граф профиля по общей топологии
+    graph::DirectedWeightedGraph<RouteWeight> BuildProfileGraph(size_t vertex_count, const std::vector<TopologyEdge>& topology, const RoutingProfile& profile){
+        return graph::DirectedWeightedGraph<RouteWeight>(vertex_count, MakeProfileEdges(topology.begin(), topology.end(), profile));
+    }
+
+    //Поездки без пересадки автобуса bus в обоих направлениях. Из параллельных поездок остается самая короткая,
+    //как в AddStopEdges, и только если в графе graph нет ребра той же пары не длиннее.
+    //Возвращает число отброшенных поездок
+    size_t CollectBusEdges(const Bus& bus, const graph::DirectedWeightedGraph<RouteWeight>& graph, const std::vector<TopologyEdge>& topology,
+                           std::vector<TopologyEdge>& edges, std::vector<EdgeInfo>& edges_info){
+        std::map<std::pair<uint32_t, uint32_t>, size_t> positions;
+        size_t dominated_count = 0;
+        const size_t stops_count = bus.stops.size();
+        for(const bool reverse : {false, true}){
+            if(reverse && bus.is_round){
+                continue;
+            }
+            for(size_t i = 0; i < stops_count; i++){
+                const size_t from = reverse ? stops_count - 1 - i : i;
+                for(size_t j = i + 1; j < stops_count; j++){
+                    const size_t to = reverse ? stops_count - 1 - j : j;
+                    const TopologyEdge edge{bus.stops[from]->id * 2 + 1, bus.stops[to]->id * 2, bus.GetRoadDistance(from, to)};
+                    const EdgeInfo edge_info{bus.id, static_cast<int>(j - i)};
+                    const auto [it, inserted] = positions.emplace(std::make_pair(edge.from, edge.to), edges.size());
+                    if(inserted){
+                        edges.push_back(edge);
+                        edges_info.push_back(edge_info);
+                        continue;
+                    }
+                    dominated_count++;
+                    if(edge.distance < edges[it->second].distance){
+                        edges[it->second] = edge;
+                        edges_info[it->second] = edge_info;
+                    }
+                }
+            }
+        }
+
+        size_t kept = 0;
+        for(size_t i = 0; i < edges.size(); i++){
+            const auto incident = graph.GetIncidentEdges(edges[i].from);
+            const bool dominated = std::any_of(incident.begin(), incident.end(), [&](graph::EdgeId id){
+                return topology[id].to == edges[i].to && topology[id].distance <= edges[i].distance;
+            });
+            if(dominated){
+                dominated_count++;
+                continue;
+            }
+            edges[kept] = edges[i];
+            edges_info[kept] = edges_info[i];
+            kept++;
+        }
+        edges.resize(kept);
+        edges_info.resize(kept);
+        return dominated_count;
     }
 }
 
-void TransportRouter::SetRoutingSettings(int bus_wait_time, double bus_velocity){
-    bus_wait_time_ = bus_wait_time;
-    bus_velocity_ = bus_velocity;
+void TransportRouter::SetRoutingSettings(const RoutingSettings& settings){
+    if(has_settings_ && !built_){
+        ++skipped_build_count_;
+    }
+    settings_ = settings;
+    has_settings_ = true;
+    built_ = false;
+    build_flag_ = std::make_unique<std::once_flag>();
 }
 
-RouteInfo TransportRouter::GetRoute(std::string_view from, std::string_view to) const{
-    size_t from_index = static_cast<size_t>(catalogue_.FindStopIndex(from).value());
-    size_t to_index = static_cast<size_t>(catalogue_.FindStopIndex(to).value());
+void TransportRouter::ResetProfiles(){
+    profiles_.clear();
+    profiles_.push_back(std::make_unique<ProfileEngine>());
+    profiles_.back()->profile = {"", settings_.bus_wait_time, settings_.bus_velocity};
+    for(const RoutingProfile& profile : settings_.profiles){
+        const bool duplicate = std::any_of(profiles_.begin(), profiles_.end(), [&profile](const auto& engine){
+            return engine->profile.name == profile.name;
+        });
+        if(profile.name.empty() || duplicate){
+            throw std::invalid_argument("routing profile names must be unique and non-empty");
+        }
+        profiles_.push_back(std::make_unique<ProfileEngine>());
+        profiles_.back()->profile = profile;
+    }
+    const ProfileEngine& engine = GetProfileEngine({});
+    stats_.relax_kernel = engine.relax_kernel;
+    stats_.shortcut_count = engine.shortcut_count;
+    stats_.label_count = engine.label_count;
+    stats_.index_bytes = engine.index_bytes;
+}
+
+//Проверяется по настройкам, чтобы не строить роутер ради проверки запроса
+bool TransportRouter::HasProfile(std::string_view profile) const{
+    return profile.empty() || std::any_of(settings_.profiles.begin(), settings_.profiles.end(), [profile](const RoutingProfile& routing_profile){
+        return routing_profile.name == profile;
+    });
+}
+
+const TransportRouter::ProfileEngine& TransportRouter::GetProfileEngine(std::string_view profile) const{
+    const auto it = std::find_if(profiles_.begin(), profiles_.end(), [profile](const auto& engine){
+        return engine->profile.name == profile;
+    });
+    if(it == profiles_.end()){
+        throw std::invalid_argument("unknown routing profile: " + std::string(profile));
+    }
+    ProfileEngine& engine = **it;
+    std::call_once(engine.build_flag, [this, &engine]{
+        BuildProfileEngine(engine);
+    });
+    return engine;
+}
 
-    auto route = router_.BuildRoute(from_index*2, to_index*2);
+//Движок выбран в CreateGraph и общий для профилей: оценки от весов не зависят
+void TransportRouter::BuildProfileEngine(ProfileEngine& engine) const{
+    const auto start = std::chrono::steady_clock::now();
+    const RoutingProfile& profile = engine.profile;
+    if(stats_.engine == RouterEngine::RAPTOR){
+        //Линии основного профиля уже собраны по справочнику, остальным достаются их копии с другими весами.
+        //Веса в тиках те же, что у ребер графа профиля
+        const double speed = details::GetSpeed(profile);
+        const RouteWeight wait_weight = details::GetWaitWeight(profile);
+        const RaptorRouter& raptor = &engine == profiles_.front().get()
+                                         ? engine.raptor.emplace(catalogue_, profile.bus_wait_time, speed, wait_weight, TicksPerMeter)
+                                         : engine.raptor.emplace(profiles_.front()->raptor->WithProfile(profile.bus_wait_time, speed, wait_weight));
+        engine.index_bytes = raptor.GetMemoryBytes();
+    }
+    else{
+        graph::DirectedWeightedGraph<RouteWeight> graph = details::BuildProfileGraph(stats_.vertex_count, topology_, profile);
+        switch(stats_.engine){
+        case RouterEngine::AUTO:
+        case RouterEngine::RAPTOR:
+        case RouterEngine::ALL_PAIRS:
+            engine.router.emplace<graph::Router<RouteWeight>>(std::move(graph), settings_.thread_count);
+            engine.relax_kernel = graph::details::GetRelaxRowKernelName();
+            engine.index_bytes = graph::Router<RouteWeight>::EstimateMemory(stats_.vertex_count);
+            break;
+        case RouterEngine::DIJKSTRA:
+            engine.router.emplace<graph::DijkstraRouter<RouteWeight>>(std::move(graph));
+            break;
+        case RouterEngine::SOURCE_CACHED:
+            engine.router.emplace<graph::SourceCachedRouter<RouteWeight>>(std::move(graph), settings_.source_cache_bytes);
+            break;
+        case RouterEngine::CONTRACTION_HIERARCHY: {
+            const auto& hierarchy = engine.router.emplace<graph::ContractionHierarchy<RouteWeight>>(std::move(graph));
+            engine.shortcut_count = hierarchy.GetShortcutCount();
+            engine.index_bytes = hierarchy.GetIndexBytes();
+            break;
+        }
+        case RouterEngine::HUB_LABELS: {
+            const auto& labels = engine.router.emplace<graph::HubLabelRouter<RouteWeight>>(std::move(graph), settings_.thread_count);
+            engine.label_count = labels.GetLabelCount();
+            engine.index_bytes = labels.GetIndexBytes();
+            break;
+        }
+        }
+    }
+    engine.build_duration_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    engine.built = true;
+}
+
+const graph::DirectedWeightedGraph<RouteWeight>& TransportRouter::GetGraph(const ProfileEngine& engine) const{
+    return std::visit([](const auto& router) -> const graph::DirectedWeightedGraph<RouteWeight>& {
+        return router.GetGraph();
+    }, engine.router);
+}
+
+RouteInfo TransportRouter::MakeRaptorRouteInfo(const ProfileEngine& engine, const std::optional<std::vector<JourneyLeg>>& journey) const{
+    if(!journey){
+        return RouteInfo{std::nullopt, {}};
+    }
+
+    const int bus_wait_time = engine.profile.bus_wait_time;
+    std::vector<std::variant<WaitBusInfo, WaitStopInfo>> wait;
+    double total_time = 0;
+    for(const JourneyLeg& leg : *journey){
+        total_time += bus_wait_time;
+        wait.emplace_back(WaitStopInfo("Wait", bus_wait_time, catalogue_.GetStop(leg.from_stop).name));
+        total_time += leg.time;
+        wait.emplace_back(WaitBusInfo("Bus", leg.time, leg.span_count, catalogue_.GetBus(leg.bus).name));
+    }
+    return RouteInfo{total_time, wait};
+}
+
+RouteInfo TransportRouter::MakeRouteInfo(const ProfileEngine& engine, const std::optional<GraphRoute>& route) const{
     std::vector<std::variant<WaitBusInfo, WaitStopInfo>> wait;
     double total_time = 0;
-    const graph::DirectedWeightedGraph<double>& graph = router_.GetGraph();
 
     if(route.has_value()){
         for(auto edgeid : route.value().edges){
-            auto edge = graph.FindEdge(edgeid);
-            std::string stop_name_from = catalogue_.GetStops().at(edge.from/2).name;
-            std::string stop_name_to = catalogue_.GetStops().at(edge.to/2).name;
-            total_time += edge.weight;
+            const TopologyEdge& edge = topology_.at(edgeid);
+            const std::string& stop_name_from = catalogue_.GetStop(edge.from/2).name;
+            const double time = details::GetEdgeTime(edge, engine.profile);
+            total_time += time;
 
-            if(edge.from % 2 == 0 && edge.to - edge.from == 1){
-                wait.emplace_back(WaitStopInfo("Wait", edge.weight, catalogue_.GetStops().at(edge.from/2).name));
+            if(details::IsWaitEdge(edge)){
+                wait.emplace_back(WaitStopInfo("Wait", time, stop_name_from));
             }
             else{
-                std::vector<std::string_view> v1 = catalogue_.FindStopToBus(catalogue_.GetStops().at(edge.from/2).name);
-                std::vector<std::string_view> v2 = catalogue_.FindStopToBus(catalogue_.GetStops().at(edge.to/2).name);
-
-                auto [bus_name, stops_count] = catalogue_.FindBusNameByTwoStopsAndDistance(stop_name_from, stop_name_to, edge.weight * bus_velocity_ * CoefficientSpeedConversion);
-                wait.emplace_back(WaitBusInfo("Bus", edge.weight, stops_count, bus_name));
+                const EdgeInfo& edge_info = edges_info_[edgeid];
+                wait.emplace_back(WaitBusInfo("Bus", time, edge_info.span_count, catalogue_.GetBus(edge_info.bus).name));
             }
         }
         return RouteInfo{total_time, wait};
@@ -77,25 +426,394 @@ RouteInfo TransportRouter::GetRoute(std::string_view from, std::string_view to)
     return RouteInfo{std::nullopt, {}};
 }
 
-void TransportRouter::CreateGraph(){
-    const std::deque<Bus>& buses = catalogue_.GetBuses();
-    graph::DirectedWeightedGraph<double> graph(catalogue_.GetStopsCount()*2);
+StopId TransportRouter::GetStopId(std::string_view name) const{
+    const Stop* stop = catalogue_.FindStop(name);
+    if(stop == nullptr){
+        throw std::runtime_error("stop is not found");
+    }
+    return stop->id;
+}
+
+RouteInfo TransportRouter::GetRoute(std::string_view from, std::string_view to, std::string_view profile) const{
+    const StopId from_index = GetStopId(from);
+    const StopId to_index = GetStopId(to);
+    EnsureBuilt();
+    const ProfileEngine& engine = GetProfileEngine(profile);
+
+    const auto start = std::chrono::steady_clock::now();
+    if(engine.raptor){
+        const auto journey = engine.raptor->BuildJourney(from_index, to_index);
+        route_nanoseconds_ += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        ++route_count_;
+        return MakeRaptorRouteInfo(engine, journey);
+    }
+    auto route = std::visit([from_index, to_index](const auto& router){
+        return router.BuildRoute(from_index*2, to_index*2);
+    }, engine.router);
+    route_nanoseconds_ += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    ++route_count_;
+    return MakeRouteInfo(engine, route);
+}
 
-    for(size_t i = 0; i < catalogue_.GetStopsCount()*2; i += 2){
-        graph.AddEdge(graph::Edge<double>(i, static_cast<size_t>(i + 1), bus_wait_time_));
+//Маршруты графа из from в каждую из to_stops: одним поиском, если движок его умеет, иначе по парам
+std::vector<std::optional<TransportRouter::GraphRoute>> TransportRouter::BuildGraphRoutes(const ProfileEngine& engine, StopId from,
+                                                                                          const std::vector<StopId>& to_stops) const{
+    std::vector<graph::VertexId> targets;
+    targets.reserve(to_stops.size());
+    for(const StopId to : to_stops){
+        targets.push_back(to * 2);
     }
-    
-    for(auto bus : buses){
-        if(bus.is_round){
-            details::ParseBusToEdges(bus.stops.begin(), bus.stops.end(), bus_velocity_, catalogue_, graph);
+    return std::visit([from, &targets](const auto& router){
+        if constexpr(details::HasBuildRoutes<std::decay_t<decltype(router)>>::value){
+            return router.BuildRoutes(from * 2, targets);
         }
         else{
-            details::ParseBusToEdges(bus.stops.begin(), bus.stops.end(), bus_velocity_, catalogue_, graph);
-            details::ParseBusToEdges(bus.stops.rbegin(), bus.stops.rend(), bus_velocity_, catalogue_, graph);
+            std::vector<std::optional<GraphRoute>> result;
+            result.reserve(targets.size());
+            for(const graph::VertexId to : targets){
+                result.push_back(router.BuildRoute(from * 2, to));
+            }
+            return result;
+        }
+    }, engine.router);
+}
+
+std::vector<RouteInfo> TransportRouter::BuildGroupRoutes(const ProfileEngine& engine, StopId from, const std::vector<StopId>& to_stops) const{
+    std::vector<RouteInfo> routes;
+    routes.reserve(to_stops.size());
+    if(engine.raptor){
+        for(const StopId to : to_stops){
+            routes.push_back(MakeRaptorRouteInfo(engine, engine.raptor->BuildJourney(from, to)));
+        }
+        return routes;
+    }
+    for(const auto& route : BuildGraphRoutes(engine, from, to_stops)){
+        routes.push_back(MakeRouteInfo(engine, route));
+    }
+    return routes;
+}
+
+std::vector<RouteInfo> TransportRouter::GetRoutes(const std::vector<std::pair<std::string_view, std::string_view>>& pairs, std::string_view profile) const{
+    std::vector<StopId> from_stops;
+    std::vector<StopId> to_stops;
+    from_stops.reserve(pairs.size());
+    to_stops.reserve(pairs.size());
+    for(const auto& [from, to] : pairs){
+        from_stops.push_back(GetStopId(from));
+        to_stops.push_back(GetStopId(to));
+    }
+    EnsureBuilt();
+    const ProfileEngine& engine = GetProfileEngine(profile);
+
+    //Пары упорядочиваются по остановке отправления; группа - подряд идущие пары с общим началом
+    std::vector<size_t> order(pairs.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&from_stops](size_t lhs, size_t rhs){
+        return from_stops[lhs] < from_stops[rhs];
+    });
+    std::vector<size_t> group_begins;
+    for(size_t i = 0; i < order.size(); i++){
+        if(i == 0 || from_stops[order[i]] != from_stops[order[i - 1]]){
+            group_begins.push_back(i);
+        }
+    }
+    group_begins.push_back(order.size());
+
+    std::vector<std::optional<RouteInfo>> results(pairs.size());
+    parallel::ForEachChunk(group_begins.size() - 1, settings_.thread_count, [&](size_t begin, size_t end){
+        std::vector<StopId> group_to_stops;
+        for(size_t group = begin; group < end; group++){
+            group_to_stops.clear();
+            for(size_t i = group_begins[group]; i < group_begins[group + 1]; i++){
+                group_to_stops.push_back(to_stops[order[i]]);
+            }
+            const auto start = std::chrono::steady_clock::now();
+            std::vector<RouteInfo> routes = BuildGroupRoutes(engine, from_stops[order[group_begins[group]]], group_to_stops);
+            route_nanoseconds_ += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+            route_count_ += routes.size();
+            for(size_t i = 0; i < routes.size(); i++){
+                results[order[group_begins[group] + i]] = std::move(routes[i]);
+            }
+        }
+    });
+
+    std::vector<RouteInfo> routes;
+    routes.reserve(results.size());
+    for(auto& route : results){
+        routes.push_back(std::move(*route));
+    }
+    return routes;
+}
+
+TravelTimeMatrix TransportRouter::GetMatrix(const std::vector<std::string_view>& from_stops, const std::vector<std::string_view>& to_stops,
+                                            std::string_view profile) const{
+    std::vector<StopId> from_indices;
+    std::vector<StopId> to_indices;
+    from_indices.reserve(from_stops.size());
+    to_indices.reserve(to_stops.size());
+    for(const std::string_view from : from_stops){
+        from_indices.push_back(GetStopId(from));
+    }
+    for(const std::string_view to : to_stops){
+        to_indices.push_back(GetStopId(to));
+    }
+    EnsureBuilt();
+    const ProfileEngine& engine = GetProfileEngine(profile);
+
+    const auto start = std::chrono::steady_clock::now();
+    TravelTimeMatrix matrix(from_indices.size(), std::vector<std::optional<double>>(to_indices.size()));
+    if(const auto* hierarchy = std::get_if<graph::ContractionHierarchy<RouteWeight>>(&engine.router); hierarchy && !engine.raptor){
+        std::vector<graph::VertexId> sources;
+        std::vector<graph::VertexId> targets;
+        for(const StopId from : from_indices){
+            sources.push_back(from * 2);
+        }
+        for(const StopId to : to_indices){
+            targets.push_back(to * 2);
+        }
+        const auto weights = hierarchy->BuildDistanceMatrix(sources, targets, settings_.thread_count);
+        const double ticks_per_minute = details::GetTicksPerMinute(engine.profile);
+        for(size_t i = 0; i < from_indices.size(); i++){
+            for(size_t j = 0; j < to_indices.size(); j++){
+                if(const auto& weight = weights[i * to_indices.size() + j]){
+                    matrix[i][j] = static_cast<double>(*weight) / ticks_per_minute;
+                }
+            }
+        }
+    }
+    else{
+        parallel::ForEachChunk(from_indices.size(), settings_.thread_count, [&](size_t begin, size_t end){
+            for(size_t i = begin; i < end; i++){
+                if(engine.raptor){
+                    for(size_t j = 0; j < to_indices.size(); j++){
+                        matrix[i][j] = MakeRaptorRouteInfo(engine, engine.raptor->BuildJourney(from_indices[i], to_indices[j])).total_time_;
+                    }
+                    continue;
+                }
+                const auto routes = BuildGraphRoutes(engine, from_indices[i], to_indices);
+                for(size_t j = 0; j < routes.size(); j++){
+                    if(!routes[j]){
+                        continue;
+                    }
+                    //Время складывается по ребрам, как в MakeRouteInfo, поэтому совпадает с временем маршрута
+                    double time = 0;
+                    for(const graph::EdgeId edge_id : routes[j]->edges){
+                        time += details::GetEdgeTime(topology_[edge_id], engine.profile);
+                    }
+                    matrix[i][j] = time;
+                }
+            }
+        });
+    }
+    matrix_nanoseconds_ += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    matrix_cell_count_ += from_indices.size() * to_indices.size();
+    return matrix;
+}
+
+std::vector<ReachableStop> TransportRouter::GetReachable(std::string_view from, double max_time, std::string_view profile) const{
+    const StopId from_index = GetStopId(from);
+    EnsureBuilt();
+    const ProfileEngine& engine = GetProfileEngine(profile);
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<ReachableStop> reachable;
+    const double ticks_per_minute = details::GetTicksPerMinute(engine.profile);
+    const RouteWeight max_weight = std::llround(max_time * ticks_per_minute);
+    if(engine.raptor){
+        for(const auto& [stop, weight] : engine.raptor->FindReachable(from_index, max_weight)){
+            reachable.push_back({catalogue_.GetStop(stop).name, static_cast<double>(weight) / ticks_per_minute});
+        }
+    }
+    else{
+        //Прибытие на остановку - четная вершина, нечетные вершины после ожидания пропускаются
+        for(const auto& [vertex, weight] : graph::DijkstraRouter<RouteWeight>::FindReachable(GetGraph(engine), from_index * 2, max_weight)){
+            if(vertex % 2 == 0){
+                reachable.push_back({catalogue_.GetStop(vertex / 2).name, static_cast<double>(weight) / ticks_per_minute});
+            }
+        }
+    }
+    std::sort(reachable.begin(), reachable.end(), [](const ReachableStop& lhs, const ReachableStop& rhs){
+        return std::tie(lhs.time_, lhs.stop_name_) < std::tie(rhs.time_, rhs.stop_name_);
+    });
+    reachable_nanoseconds_ += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    ++reachable_count_;
+    return reachable;
+}
+
+void TransportRouter::CreateGraph(){
+    std::call_once(*build_flag_, [this]{
+        BuildGraph();
+    });
+}
+
+void TransportRouter::EnsureBuilt() const{
+    if(!built_){
+        const_cast<TransportRouter*>(this)->CreateGraph();
+    }
+}
+
+void TransportRouter::BuildGraph(){
+    if(!catalogue_.IsFinalized()){
+        throw std::logic_error("catalogue must be finalized before building the router");
+    }
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<BusUpdateStats> bus_updates = std::move(stats_.bus_updates);
+    stats_ = RouterStats{};
+    stats_.bus_updates = std::move(bus_updates);
+    stats_.vertex_count = catalogue_.GetStopsCount()*2;
+    distances_version_ = catalogue_.GetDistancesVersion();
+    stats_.edge_count = details::CountGraphEdges(catalogue_);
+    stats_.estimates = details::EstimateEngines(stats_.vertex_count, stats_.edge_count, RaptorRouter::CountLinePositions(catalogue_), settings_);
+    stats_.engine_forced = settings_.engine != RouterEngine::AUTO;
+    stats_.engine = stats_.engine_forced ? settings_.engine : details::ChooseEngine(stats_.estimates, settings_.memory_limit_bytes);
+    topology_.clear();
+    edges_info_.clear();
+    profiles_.clear();
+
+    //RAPTOR работает по остановкам автобусов, граф для него не строится
+    if(stats_.engine != RouterEngine::RAPTOR){
+        //Ребра строятся по остановкам отправления: куски подряд идущих остановок обрабатываются
+        //параллельно, и лишние параллельные ребра отбрасываются сразу. Буферы кусков сливаются по порядку,
+        //поэтому ребра отсортированы по началу, а их нумерация не зависит от числа потоков
+        std::vector<size_t> visit_offsets;
+        std::vector<details::StopVisit> visits;
+        details::CollectStopVisits(catalogue_, visit_offsets, visits);
+        const size_t stops_count = catalogue_.GetStopsCount();
+        const size_t chunk_count = std::max<size_t>(1, std::min(settings_.thread_count, stops_count));
+        const size_t chunk_size = (stops_count + chunk_count - 1) / chunk_count;
+        std::vector<details::EdgeBuffer> buffers(chunk_count);
+        std::vector<size_t> dominated_counts(chunk_count, 0);
+        parallel::ForEachChunk(chunk_count, chunk_count, [&](size_t begin, size_t end){
+            std::vector<size_t> target_marks(stats_.vertex_count, stops_count);
+            std::vector<size_t> target_edges(stats_.vertex_count);
+            for(size_t chunk = begin; chunk < end; chunk++){
+                //Первый буфер станет общим массивом ребер. Резерв по верхней оценке не трогает лишнюю память,
+                //пока в нее не пишут, зато буферы не перевыделяются
+                const size_t capacity = chunk == 0 ? stats_.edge_count : stats_.edge_count / chunk_count;
+                buffers[chunk].edges.reserve(capacity);
+                buffers[chunk].edges_info.reserve(capacity);
+                for(StopId stop = chunk * chunk_size; stop < std::min(stops_count, (chunk + 1) * chunk_size); stop++){
+                    dominated_counts[chunk] += details::AddStopEdges(stop, visits.data() + visit_offsets[stop], visits.data() + visit_offsets[stop + 1],
+                                                                     target_marks, target_edges, buffers[chunk]);
+                }
+            }
+        });
+
+        topology_ = std::move(buffers[0].edges);
+        edges_info_ = std::move(buffers[0].edges_info);
+        stats_.dominated_edge_count = dominated_counts[0];
+        for(size_t chunk = 1; chunk < chunk_count; chunk++){
+            topology_.insert(topology_.end(), buffers[chunk].edges.begin(), buffers[chunk].edges.end());
+            edges_info_.insert(edges_info_.end(), buffers[chunk].edges_info.begin(), buffers[chunk].edges_info.end());
+            buffers[chunk] = {};
+            stats_.dominated_edge_count += dominated_counts[chunk];
         }
+        stats_.edge_count = topology_.size();
     }
 
-    router_ = graph::Router(std::move(graph));
+    ResetProfiles();
+    stats_.build_duration_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    built_ = true;
+    ++build_count_;
 }
 
-}
\ No newline at end of file
+BusUpdateStats TransportRouter::AddBus(std::string_view name){
+    const Bus* bus = catalogue_.FindBus(name);
+    if(bus == nullptr){
+        throw std::runtime_error("bus is not found");
+    }
+    if(!catalogue_.IsFinalized()){
+        throw std::logic_error("catalogue must be finalized before updating the router");
+    }
+    const auto start = std::chrono::steady_clock::now();
+    BusUpdateStats update;
+    update.bus_name = bus->name;
+    const bool data_changed = catalogue_.GetStopsCount() * 2 != stats_.vertex_count || catalogue_.GetDistancesVersion() != distances_version_;
+    if(!built_ || data_changed){
+        //Непостроенный роутер соберет граф с автобусом при первом запросе
+        if(built_){
+            BuildGraph();
+            ++distance_rebuild_count_;
+        }
+        update.duration_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        stats_.bus_updates.push_back(update);
+        return update;
+    }
+
+    //У RAPTOR нет топологии: его линии собираются по справочнику заново
+    const size_t first_edge = topology_.size();
+    if(stats_.engine != RouterEngine::RAPTOR){
+        std::vector<TopologyEdge> edges;
+        std::vector<EdgeInfo> edges_info;
+        update.dominated_edge_count = details::CollectBusEdges(*bus, GetGraph(*profiles_.front()), topology_, edges, edges_info);
+        update.added_edge_count = edges.size();
+        topology_.insert(topology_.end(), edges.begin(), edges.end());
+        edges_info_.insert(edges_info_.end(), edges_info.begin(), edges_info.end());
+        stats_.edge_count = topology_.size();
+        stats_.dominated_edge_count += update.dominated_edge_count;
+    }
+
+    //Таблица всех пар дополняется новыми ребрами; непостроенные профили построятся по новой топологии сами
+    update.incremental = stats_.engine == RouterEngine::ALL_PAIRS;
+    if(update.incremental){
+        for(const auto& engine : profiles_){
+            if(!engine->built){
+                continue;
+            }
+            auto& router = std::get<graph::Router<RouteWeight>>(engine->router);
+            update.relaxed_row_count += router.AddEdges(details::MakeProfileEdges(topology_.begin() + first_edge, topology_.end(), engine->profile),
+                                                        settings_.thread_count);
+        }
+    }
+    else{
+        ResetProfiles();
+    }
+    update.duration_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    stats_.bus_updates.push_back(update);
+    return update;
+}
+
+void TransportRouter::UpdateDistances(){
+    if(!built_ || (catalogue_.GetStopsCount() * 2 == stats_.vertex_count && catalogue_.GetDistancesVersion() == distances_version_)){
+        return;
+    }
+    BuildGraph();
+    ++distance_rebuild_count_;
+}
+
+RouterStats TransportRouter::GetStats() const{
+    RouterStats stats = stats_;
+    stats.built = built_;
+    stats.build_count = build_count_;
+    stats.skipped_build_count = skipped_build_count_ + (has_settings_ && !built_ ? 1 : 0);
+    stats.distance_rebuild_count = distance_rebuild_count_;
+    if(!stats.built){
+        return stats;
+    }
+    if(const auto* router = std::get_if<graph::SourceCachedRouter<RouteWeight>>(&profiles_.front()->router)){
+        stats.source_cache = router->GetCacheStats();
+    }
+    stats.route_count = route_count_;
+    if(stats.route_count > 0){
+        stats.average_route_us = static_cast<double>(route_nanoseconds_) / 1000.0 / static_cast<double>(stats.route_count);
+    }
+    stats.matrix_cell_count = matrix_cell_count_;
+    stats.matrix_duration_ms = static_cast<double>(matrix_nanoseconds_) / 1e6;
+    stats.reachable_count = reachable_count_;
+    stats.reachable_duration_ms = static_cast<double>(reachable_nanoseconds_) / 1e6;
+    for(const auto& engine : profiles_){
+        const bool built = engine->built;
+        stats.profiles.push_back({engine->profile.name, built, built ? engine->build_duration_ms : 0});
+    }
+    return stats;
+}
+
+const std::vector<TopologyEdge>& TransportRouter::GetTopology() const{
+    return topology_;
+}
+
+const std::vector<EdgeInfo>& TransportRouter::GetEdgesInfo() const{
+    return edges_info_;
+}
+
+}
@@ -2,13 +2,26 @@
 #include <string_view>
 #include <string>
 #include <sstream>
+#include <map>
 #include <optional>
 #include <variant>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 #include "transport_catalogue.h"
 #include "json_builder.h"
 #include "graph.h"
 #include "router.h"
+#include "dijkstra_router.h"
+#include "source_cached_router.h"
+#include "contraction_hierarchy.h"
+#include "hub_label_router.h"
+#include "raptor_router.h"
 
 namespace transport_router{
 
@@ -39,19 +52,263 @@ struct RouteInfo{
     RouteInfo(std::optional<double> total_time, std::vector<std::variant<WaitBusInfo, WaitStopInfo>> items) : total_time_(total_time), items_(items){}
 };
 
+// Матрица времен в пути: [i][j] - из i-й остановки отправления в j-ю остановку назначения,
+// пусто, если маршрута нет
+using TravelTimeMatrix = std::vector<std::vector<std::optional<double>>>;
+
+// Остановка, достижимая в пределах бюджета времени, и время прибытия на нее
+struct ReachableStop{
+    std::string_view stop_name_;
+    double time_;
+};
+
+// ALL_PAIRS - предрасчет всех пар (Флойд-Уоршелл), быстрые запросы и O(V^2) памяти.
+// DIJKSTRA - поиск на каждый запрос, O(V + E) памяти, подходит для больших сетей.
+// SOURCE_CACHED - один полный поиск на каждую различную остановку отправления.
+// CONTRACTION_HIERARCHY - иерархия сжатия: предобработка с ярлыками, запрос - двунаправленный поиск вверх по рангу.
+// HUB_LABELS - метки хабов: запрос - слияние двух списков, память между DIJKSTRA и ALL_PAIRS.
+// RAPTOR - раунды по последовательностям остановок автобусов без построения графа.
+// AUTO - выбор по оценке памяти и времени в CreateGraph
+enum class RouterEngine{
+    AUTO,
+    ALL_PAIRS,
+    DIJKSTRA,
+    SOURCE_CACHED,
+    CONTRACTION_HIERARCHY,
+    HUB_LABELS,
+    RAPTOR
+};
+
+// Именованный профиль маршрутизации: свои ожидание и скорость на общей топологии графа
+struct RoutingProfile{
+    std::string name;
+    int bus_wait_time = 0;
+    double bus_velocity = 0;
+};
+
+struct RoutingSettings{
+    int bus_wait_time = 0;
+    double bus_velocity = 0;
+    // Дополнительные профили к основному (bus_wait_time, bus_velocity), у которого пустое имя
+    std::vector<RoutingProfile> profiles;
+    RouterEngine engine = RouterEngine::AUTO;
+    size_t memory_limit_bytes = size_t{1} << 30;
+    // Потоки для построения таблицы всех пар
+    size_t thread_count = 1;
+    // Ожидаемое число запросов Route и различных остановок отправления в них
+    size_t expected_queries = 0;
+    size_t expected_sources = 0;
+    // Бюджет памяти кэша деревьев кратчайших путей движка SOURCE_CACHED
+    size_t source_cache_bytes = size_t{256} << 20;
+};
+
+// Оценка движка: память и число элементарных шагов на построение и все ожидаемые запросы
+struct EngineEstimate{
+    size_t memory_bytes = 0;
+    double operations = 0;
+};
+
+// Профиль и состояние его движка: построен ли и за сколько
+struct ProfileStats{
+    std::string name;
+    bool built = false;
+    double build_duration_ms = 0;
+};
+
+// Стоимость добавления автобуса в построенный роутер
+struct BusUpdateStats{
+    std::string bus_name;
+    // Поездки нового автобуса, добавленные в топологию, и отброшенные как не короче имеющихся ребер
+    size_t added_edge_count = 0;
+    size_t dominated_edge_count = 0;
+    // true - таблицы всех пар обновлены на месте, false - движки профилей перестроены
+    bool incremental = false;
+    // Строки таблиц всех пар, улучшенные новыми ребрами, по всем построенным профилям
+    size_t relaxed_row_count = 0;
+    double duration_ms = 0;
+};
+
+struct RouterStats{
+    RouterEngine engine = RouterEngine::AUTO;
+    bool engine_forced = false;
+    size_t vertex_count = 0;
+    size_t edge_count = 0;
+    std::map<RouterEngine, EngineEstimate> estimates;
+    double build_duration_ms = 0;
+    // Реализация релаксации таблицы всех пар, выбранная по возможностям процессора
+    std::string relax_kernel;
+    // Параллельные ребра, отброшенные при построении графа, потому что не легче другого ребра той же пары вершин
+    size_t dominated_edge_count = 0;
+    // Ярлыки, добавленные иерархией сжатия
+    size_t shortcut_count = 0;
+    // Объем предрасчитанного индекса движка: таблицы всех пар, ярлыков или меток
+    size_t index_bytes = 0;
+    // Число записей в метках хабов
+    size_t label_count = 0;
+    // Попадания, промахи и объем кэша деревьев движка SOURCE_CACHED
+    graph::SourceCacheStats source_cache;
+    // Запросы GetRoute и их среднее время
+    size_t route_count = 0;
+    double average_route_us = 0;
+    // Ячейки, посчитанные GetMatrix, и общее время их расчета
+    size_t matrix_cell_count = 0;
+    double matrix_duration_ms = 0;
+    // Запросы GetReachable и общее время их расчета
+    size_t reachable_count = 0;
+    double reachable_duration_ms = 0;
+    // Все профили, основной первым
+    std::vector<ProfileStats> profiles;
+    // Автобусы, добавленные после настройки роутера, по порядку
+    std::vector<BusUpdateStats> bus_updates;
+    // Построены ли граф и движки. Построение откладывается до первого запроса маршрута
+    bool built = false;
+    // Построения графа и движков, включая перестроения
+    size_t build_count = 0;
+    // Настройки, так и не понадобившиеся ни одному запросу: построение по ним пропущено
+    size_t skipped_build_count = 0;
+    // Полные перестроения из-за расстояний или остановок, добавленных в справочник после построения
+    size_t distance_rebuild_count = 0;
+};
+
+// Автобус и число пролетов, которые проезжает ребро графа. У ребер ожидания span_count равен 0
+struct EdgeInfo{
+    BusId bus;
+    int span_count;
+};
+
+// Вес ребра графа профиля в тиках: 1/65536 метра пути со скоростью профиля. Поездка весит
+// расстояние в тиках точно, ожидание округляется до тика. Целые веса складываются без погрешности,
+// поэтому все движки одинаково сравнивают пути. Время маршрута считается по топологии в минутах
+using RouteWeight = int64_t;
+
+// Ребро графа без веса: концы и дорожное расстояние поездки, у ребра ожидания - 0.
+// Вес выводится из профиля, поэтому топология общая для всех профилей
+struct TopologyEdge{
+    uint32_t from;
+    uint32_t to;
+    int distance;
+};
+
+namespace details{
+    // Движок умеет искать маршруты из одной вершины во многие одним поиском
+    template <typename Engine, typename = void>
+    struct HasBuildRoutes : std::false_type{};
+
+    template <typename Engine>
+    struct HasBuildRoutes<Engine, std::void_t<decltype(std::declval<const Engine&>().BuildRoutes(graph::VertexId{}, std::declval<const std::vector<graph::VertexId>&>()))>> : std::true_type{};
+
+    // Выбор движка для AUTO без построения графа: число ребер по справочнику, оценки движков
+    // и самый дешевый из помещающихся в лимит памяти
+    size_t CountGraphEdges(const transport_catalogue::TransportCatalogue& catalogue);
+    std::map<RouterEngine, EngineEstimate> EstimateEngines(size_t vertex_count, size_t edge_count, size_t line_positions, const RoutingSettings& settings);
+    RouterEngine ChooseEngine(const std::map<RouterEngine, EngineEstimate>& estimates, size_t memory_limit_bytes);
+}
+
 class TransportRouter{
 public:
     TransportRouter() = default;
     TransportRouter(const transport_catalogue::TransportCatalogue& catalogue) : catalogue_(catalogue){}
 
-    void SetRoutingSettings(int bus_wait_time, double bus_velocity);
-    RouteInfo GetRoute(std::string_view from, std::string_view to) const;
+    void SetRoutingSettings(const RoutingSettings& settings);
+    // Запросы принимают имя профиля, пустое - основной профиль. Движок профиля строится при первом
+    // запросе к нему по общей топологии, без повторного обхода справочника.
+    // Неизвестный профиль - std::invalid_argument
+    bool HasProfile(std::string_view profile) const;
+    RouteInfo GetRoute(std::string_view from, std::string_view to, std::string_view profile = {}) const;
+    // Маршруты для пар остановок (from, to). Пары группируются по остановке отправления, группы
+    // считаются параллельно, на группу - один поиск "один ко многим", если движок его умеет.
+    // Результаты идут в порядке пар
+    std::vector<RouteInfo> GetRoutes(const std::vector<std::pair<std::string_view, std::string_view>>& pairs, std::string_view profile = {}) const;
+    // Времена в пути из каждой from_stops в каждую to_stops без разбивки на участки. Иерархия сжатия
+    // считает матрицу алгоритмом с корзинами. Остальные движки корзин не имеют и считают строку матрицы
+    // так же, как GetRoutes группу запросов: DIJKSTRA и SOURCE_CACHED - одним поиском "один ко многим"
+    // из остановки отправления, ALL_PAIRS - по готовой таблице, HUB_LABELS и RAPTOR - запросом на каждую пару.
+    // Корзины нужны, чтобы не искать от каждого источника по всему графу; Дейкстре они не дают
+    // ничего сверх одного поиска на строку. Остановки отправления обрабатываются параллельно
+    TravelTimeMatrix GetMatrix(const std::vector<std::string_view>& from_stops, const std::vector<std::string_view>& to_stops,
+                               std::string_view profile = {}) const;
+    // Остановки, на которые из from можно прибыть не позже чем за max_time минут, включая саму from,
+    // по возрастанию времени, при равенстве - по названию. Поиск по графу не раскрывает вершины дальше бюджета
+    std::vector<ReachableStop> GetReachable(std::string_view from, double max_time, std::string_view profile = {}) const;
+    // Строит граф и движки, если они еще не построены по текущим настройкам. Запросы маршрутов
+    // вызывают его сами, поэтому роутер без таких запросов не строится. Безопасен для параллельных вызовов
     void CreateGraph();
+    // Добавляет в роутер автобус, уже добавленный в справочник. До построения роутера только
+    // учитывает автобус: граф соберется с ним. Иначе поездки автобуса дописываются в общую топологию;
+    // таблицы всех пар обновляются на месте за O(V^2) на ребро, остальные движки перестраиваются
+    // по топологии. Новые остановки меняют число вершин, а новые расстояния - веса поездок прежних
+    // автобусов, тогда роутер строится заново
+    BusUpdateStats AddBus(std::string_view name);
+    // Учитывает расстояния и остановки, добавленные в справочник после построения роутера. Расстояние
+    // меняет веса поездок всех автобусов через перегон, поэтому граф и движки строятся заново.
+    // Непостроенный роутер и так соберется по новым данным при первом запросе
+    void UpdateDistances();
+    RouterStats GetStats() const;
+    // Ребра общей топологии по EdgeId и автобусы их поездок. Пусты до построения и у RAPTOR
+    const std::vector<TopologyEdge>& GetTopology() const;
+    const std::vector<EdgeInfo>& GetEdgesInfo() const;
 
 private:
-    int bus_wait_time_;
-    double bus_velocity_;
-    graph::Router<double> router_;
+    using Engine = std::variant<graph::Router<RouteWeight>, graph::DijkstraRouter<RouteWeight>, graph::SourceCachedRouter<RouteWeight>,
+                                graph::ContractionHierarchy<RouteWeight>, graph::HubLabelRouter<RouteWeight>>;
+    using GraphRoute = graph::Router<RouteWeight>::RouteInfo;
+
+    // Движок одного профиля. Основной строится в CreateGraph, остальные - при первом запросе
+    struct ProfileEngine{
+        RoutingProfile profile;
+        Engine router;
+        // Задан, если выбран RAPTOR; тогда router пуст
+        std::optional<RaptorRouter> raptor;
+        std::string relax_kernel;
+        size_t shortcut_count = 0;
+        size_t label_count = 0;
+        size_t index_bytes = 0;
+        double build_duration_ms = 0;
+        std::once_flag build_flag;
+        std::atomic<bool> built{false};
+    };
+
+    // Строит по справочнику топологию и основной движок
+    void BuildGraph();
+    // Построение из константных запросов: сам роутер не константный, меняется только однажды под call_once
+    void EnsureBuilt() const;
+    // Пересоздает движки всех профилей по settings_ и строит основной
+    void ResetProfiles();
+    // Движок профиля, построенный при необходимости. Безопасен для параллельных запросов
+    const ProfileEngine& GetProfileEngine(std::string_view profile) const;
+    void BuildProfileEngine(ProfileEngine& engine) const;
+    const graph::DirectedWeightedGraph<RouteWeight>& GetGraph(const ProfileEngine& engine) const;
+    StopId GetStopId(std::string_view name) const;
+    // Участки и время маршрута графа: ожидание - bus_wait_time профиля, поездка - расстояние на скорость
+    RouteInfo MakeRouteInfo(const ProfileEngine& engine, const std::optional<GraphRoute>& route) const;
+    RouteInfo MakeRaptorRouteInfo(const ProfileEngine& engine, const std::optional<std::vector<JourneyLeg>>& journey) const;
+    std::vector<std::optional<GraphRoute>> BuildGraphRoutes(const ProfileEngine& engine, StopId from,
+                                                            const std::vector<StopId>& to_stops) const;
+    std::vector<RouteInfo> BuildGroupRoutes(const ProfileEngine& engine, StopId from, const std::vector<StopId>& to_stops) const;
+
+    RoutingSettings settings_;
+    // Основной профиль первым. Движки не перемещаются: на них ссылаются идущие запросы
+    std::vector<std::unique_ptr<ProfileEngine>> profiles_;
+    RouterStats stats_;
+    // Отложенное построение по текущим настройкам; флаг пересоздается в SetRoutingSettings
+    std::unique_ptr<std::once_flag> build_flag_ = std::make_unique<std::once_flag>();
+    std::atomic<bool> built_{false};
+    bool has_settings_ = false;
+    size_t build_count_ = 0;
+    size_t skipped_build_count_ = 0;
+    size_t distance_rebuild_count_ = 0;
+    // Версия расстояний справочника, по которой построен граф
+    size_t distances_version_ = 0;
+    // Счетчики GetRoute, атомарные для параллельных запросов
+    mutable std::atomic<size_t> route_count_{0};
+    mutable std::atomic<uint64_t> route_nanoseconds_{0};
+    mutable std::atomic<size_t> matrix_cell_count_{0};
+    mutable std::atomic<uint64_t> matrix_nanoseconds_{0};
+    mutable std::atomic<size_t> reachable_count_{0};
+    mutable std::atomic<uint64_t> reachable_nanoseconds_{0};
+    // Топология графа и описания ребер, общие для всех профилей; пусты у RAPTOR
+    std::vector<TopologyEdge> topology_;
+    std::vector<EdgeInfo> edges_info_;
     const transport_catalogue::TransportCatalogue& catalogue_;
 };
 